@@ -1,53 +1,212 @@
 #include "PPM.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-GLubyte * LoadPPM(char* file, int* width, int* height) {
-    GLubyte* img;
-    FILE *fd;
-    int n, m;
-    int  k, nm;
-    char c;
-    int i;
-    char b[100];
-    float s;
-    int red, green, blue;
-
-    /* first open file and check if it's an ASCII PPM (indicated by P3 at the start) */
-    fd = fopen(file, "r");
-    fscanf(fd,"%[^\n] ",b);
-    if (b[0]!='P'|| b[1] != '3') {
-        printf("%s is not a PPM file!\n",file);
-        exit(0);
-    }
-    fscanf(fd, "%c",&c);
-
-    /* next, skip past the comments - any line starting with #*/
-    while (c == '#') {
-        fscanf(fd, "%[^\n] ", b);
-        fscanf(fd, "%c",&c);
-    }
-    ungetc(c,fd);
-
-    /* now get the dimensions and max colour value from the image */
-    fscanf(fd, "%d %d %d", &n, &m, &k);
-
-    /* calculate number of pixels and allocate storage for this */
-    nm = n*m;
-    img = (GLubyte*)malloc(3*sizeof(GLuint)*nm);
-    s=255.0/k;
-
-    /* for every pixel, grab the read green and blue values, storing them in the image data array */
-    for (i = 0; i < nm; i++) {
-        fscanf(fd, "%d %d %d", &red, &green, &blue);
-        img[3 * nm - 3 * i - 3] = red * s;
-        img[3 * nm - 3 * i - 2] = green * s;
-        img[3 * nm - 3 * i - 1] = blue * s;
-    }
-
-    /* finally, set the "return parameters" (width, height, max) and return the image array */
+#ifdef _WIN32
+#  define PPM_NO_MMAP
+#else
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+/* the contents of a file, either memory-mapped or read into a buffer */
+struct PPMFile {
+    const unsigned char *data;
+    size_t size;
+    int mapped;
+};
+
+/* maps (or reads) the whole file into memory, returns 0 on failure */
+static int openPPMFile(const char *file, PPMFile *out) {
+#ifdef PPM_NO_MMAP
+    FILE *fd = fopen(file, "rb");
+    if (!fd) return 0;
+    fseek(fd, 0, SEEK_END);
+    long size = ftell(fd);
+    fseek(fd, 0, SEEK_SET);
+    if (size <= 0) {
+        fclose(fd);
+        return 0;
+    }
+    unsigned char *buffer = (unsigned char*)malloc(size);
+    if (!buffer || fread(buffer, 1, size, fd) != (size_t)size) {
+        free(buffer);
+        fclose(fd);
+        return 0;
+    }
+    fclose(fd);
+    out->data = buffer;
+    out->size = size;
+    out->mapped = 0;
+    return 1;
+#else
+    int fd = open(file, O_RDONLY);
+    if (fd < 0) return 0;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return 0;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return 0;
+    /* the file is read front to back exactly once */
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    out->data = (const unsigned char*)data;
+    out->size = st.st_size;
+    out->mapped = 1;
+    return 1;
+#endif
+}
+
+static void closePPMFile(PPMFile *file) {
+#ifdef PPM_NO_MMAP
+    free((void*)file->data);
+#else
+    munmap((void*)file->data, file->size);
+#endif
+}
+
+/* whether c is whitespace as far as a PPM is concerned */
+static int isPPMSpace(unsigned char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/* skips whitespace and comments (a # runs to the end of the line) */
+static size_t skipSpace(const unsigned char *data, size_t pos, size_t size) {
+    while (pos < size) {
+        unsigned char c = data[pos];
+        if (c == '#') {
+            while (pos < size && data[pos] != '\n') pos++;
+        } else if (isPPMSpace(c)) {
+            pos++;
+        } else {
+            break;
+        }
+    }
+    return pos;
+}
+
+/* reads an unsigned decimal integer at *pos, returns -1 if there isn't one */
+static int scanInt(const unsigned char *data, size_t *pos, size_t size) {
+    size_t p = skipSpace(data, *pos, size);
+    if (p >= size || data[p] < '0' || data[p] > '9') return -1;
+    int value = 0;
+    while (p < size && data[p] >= '0' && data[p] <= '9') {
+        /* nothing valid in a PPM is anywhere near this big */
+        if (value > 100000000) return -1;
+        value = value * 10 + (data[p] - '0');
+        p++;
+    }
+    *pos = p;
+    return value;
+}
+
+/*
+ * Loads a binary (P6) or ASCII (P3) PPM. The pixels are returned as tightly
+ * packed RGB bytes in the order they appear in the file (top row first),
+ * scaled to 0-255. Returns NULL on failure, with a message in *error if
+ * error isn't NULL. The returned pixels should be released with free().
+ */
+GLubyte * LoadPPM(const char* file, int* width, int* height, const char** error) {
+    PPMFile f;
+    const char *message = NULL;
+    GLubyte *img = NULL;
+
+    if (!openPPMFile(file, &f)) {
+        if (error) *error = "could not open file";
+        return NULL;
+    }
+    const unsigned char *data = f.data;
+    size_t size = f.size;
+    size_t pos = 2;
+
+    /* first check it's a PPM (indicated by P3 or P6 at the start), then get the
+       dimensions and max colour value from the image, skipping comments */
+    int binary = size >= 2 && data[0] == 'P' && data[1] == '6';
+    int n = -1, m = -1, k = -1;
+    if (size < 2 || data[0] != 'P' || (data[1] != '3' && data[1] != '6')) {
+        message = "not a P3 or P6 PPM file";
+    } else {
+        n = scanInt(data, &pos, size);
+        m = scanInt(data, &pos, size);
+        k = scanInt(data, &pos, size);
+        if (n <= 0 || m <= 0 || k <= 0 || k > 65535) message = "invalid PPM header";
+    }
+
+    /* make sure the file really holds what the header promises before allocating anything */
+    size_t count = 0;
+    if (!message) {
+        count = (size_t)n * m * 3;
+        if (binary) {
+            /* a single whitespace character separates the header from the pixels */
+            if (pos >= size || !isPPMSpace(data[pos])) {
+                message = "invalid PPM header";
+            } else {
+                pos++;
+                size_t bytes = k < 256 ? count : count * 2;
+                if (size - pos < bytes) message = "file is truncated";
+            }
+        } else if (size - pos < count * 2 - 1) {
+            /* every value takes at least a digit, and a separator from the next one */
+            message = "file is truncated or has invalid pixel data";
+        }
+    }
+
+    if (!message) {
+        /* allocate exactly enough storage for the pixels */
+        img = (GLubyte*)malloc(count);
+        if (!img) message = "out of memory";
+    }
+
+    if (img && binary) {
+        if (k == 255) {
+            /* already in the layout we want, so just copy it */
+            memcpy(img, data + pos, count);
+        } else if (k < 256) {
+            for (size_t i = 0; i < count; i++) {
+                int v = data[pos + i];
+                if (v > k) {
+                    message = "pixel value above max colour value";
+                    break;
+                }
+                img[i] = (v * 255) / k;
+            }
+        } else {
+            /* 16 bit samples are big endian */
+            for (size_t i = 0; i < count; i++) {
+                int v = (data[pos + 2*i] << 8) | data[pos + 2*i + 1];
+                if (v > k) {
+                    message = "pixel value above max colour value";
+                    break;
+                }
+                img[i] = (v * 255) / k;
+            }
+        }
+    } else if (img) {
+        /* for every pixel, grab the red, green and blue values, storing them in the image data array */
+        for (size_t i = 0; i < count; i++) {
+            int v = scanInt(data, &pos, size);
+            if (v < 0 || v > k) {
+                message = v < 0 ? "file is truncated or has invalid pixel data" : "pixel value above max colour value";
+                break;
+            }
+            img[i] = (v * 255) / k;
+        }
+    }
+
+    closePPMFile(&f);
+    if (message) {
+        free(img);
+        if (error) *error = message;
+        return NULL;
+    }
+
+    /* finally, set the "return parameters" (width, height) and return the image array */
     *width = n;
     *height = m;
-
     return img;
 }
@@ -13,10 +13,16 @@
 #endif
 
 
+/*
+ * Loads a binary (P6) or ASCII (P3) PPM as packed RGB bytes, top row first.
+ * Returns NULL on failure and points *error (if given) at a description.
+ * The pixels are allocated with malloc.
+ */
 GLubyte * LoadPPM(
-    char * file,
+    const char * file,
     int * width,
-    int * height
+    int * height,
+    const char ** error = NULL
 );
 
 #endif
@@ -1,26 +1,38 @@
-#ifdef __APPLE__
-#include <OpenGL/gl.h>
-#include <OpenGL/glu.h>
-#include <GLUT/glut.h>
-#else
-#include <GL/gl.h>
-#include <GL/glu.h>
-#include <GL/freeglut.h>
-#endif
+#include "glExtensions.h"
 
 #include "mathLib3D.h"
 #include "camera.h"
 #include "light.h"
 #include "material.h"
 #include "PPM.h"
+#include "terrainGenerator.h"
+#include "terrainRenderer.h"
+#include "textureManager.h"
+#include "assetLoader.h"
+#include "minimap.h"
+#include "hudText.h"
+#include "riseAnimation.h"
+#include "tileStore.h"
+#include "terrainSource.h"
+#include "heightmapFile.h"
+#include "backgroundGenerator.h"
+#include "frameProfiler.h"
+#include "frameScheduler.h"
+#include "offscreenContext.h"
+#include "frameCapture.h"
+#include "cameraPath.h"
+#include "sceneLights.h"
+#include "heightQuery.h"
 #include <vector>
 #include <string>
 #include <iostream>
 #include <sstream>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <cmath>
 #include <algorithm>
+#include <chrono>
 
 // the two Vec3D represent the eye position and the lookAt position
 Camera camera = Camera(Vec3D(-5.0, 1.0, 41.0), Vec3D(-5.0, 1.0, -5.0));
@@ -32,13 +44,64 @@ int screen_height = 600;
 // movement inputs
 bool movement[] = {false, false, false, false};
 
-// size of the grid x, z
-int x_size;
-int z_size;
-
-// the height array
-float **heightmap;
-float **currentheight;
+// the camera moves in fixed steps of 1/60s, 0.5 units each, however fast frames are drawn
+FrameScheduler scheduler(1.0 / 60, 1.0 / 60);
+const float CAMERA_STEP = 0.5;
+// where the camera was at the last two steps, each frame draws it between them
+Vec3D camera_prev, camera_next;
+// whether a timer is already set for the next frame
+bool frame_pending = false;
+
+// the ground under the terrain's final heights, and whether the camera walks on it (G)
+// at EYE_HEIGHT above it rather than flying through the hills
+HeightQuery ground;
+bool ground_follow = false;
+const float EYE_HEIGHT = 1.5;
+
+// the terrain being displayed, and the generator that fills it
+TerrainState terrain;
+TerrainGenerator generator;
+
+// seed for the next terrain generation
+unsigned int seed;
+
+// builds new terrains (from the R key) on a worker thread, they're swapped in between frames
+BackgroundGenerator regenerator;
+
+// a terrain too big to hold in memory is drawn straight out of a tile store
+// instead (see --store), with tiles paged in as they're needed
+TileStore store;
+bool use_store = false;
+// how much of the store is kept in memory, in MB (see --budget)
+double store_budget = 256;
+// the highest point of each texel of the minimap, read once from the store
+Grid<float> store_overview;
+
+// what the renderer reads the terrain from, one of these two
+StateSource state_source(terrain);
+StoreSource store_source(store);
+TerrainSource *terrain_source = &state_source;
+
+// draws the terrain from buffer objects, and whether it all needs to be re-uploaded
+TerrainRenderer renderer;
+bool terrain_changed = true;
+
+// animates the terrain rising after it's generated, taking rise_duration seconds
+RiseAnimation rise;
+const double rise_duration = 4.0;
+std::chrono::steady_clock::time_point rise_start;
+// the parts of the terrain the animation changed since they were last uploaded
+std::vector<TerrainRegion> dirty_regions;
+
+// the terrain overview on the HUD
+Minimap minimap;
+
+// the HUD's text, drawn from a texture of the font
+GlyphAtlas hud_font;
+HudText hud_text(hud_font);
+// the values the HUD text was last built from
+const int HUD_VALUE_COUNT = 19;
+double hud_values[HUD_VALUE_COUNT];
 
 // rendering mode
 int render_mode = 0;
@@ -58,14 +121,11 @@ bool mesh = false;
 // light objects
 Light l, l1;
 
-// maximum height
-float max_height = 1;
-
-// normal vectors for each vertex
-Vec3D **normals;
-
 // forward declaration bc the function dependencies are a little messy
-void init_terrain();
+void init_terrain(int x_size, int z_size);
+void regenerate_terrain();
+void set_pacing(PacingMode mode);
+void save_terrain();
 
 // instructions
 const char *instructions =  "Move the camera with W/S/A/D and mouse.\n"
@@ -74,51 +134,32 @@ const char *instructions =  "Move the camera with W/S/A/D and mouse.\n"
                             "Enable and disable lighting with the L key.\n"
                             "Generate new terrain with the R key.\n"
                             "Swap between terrain textures with the T key.\n"
-                            "Swap between a quad or a triangle mesh with the M key.";
-
-// this code is directly from lab 6.
-struct Image {
-    int mWidth;
-    int mHeight;
-    GLubyte * mImage;
-
-    void load(char * filename) {
-        mImage = LoadPPM(filename, &mWidth, &mHeight);
-    }
-
-    void draw(unsigned int x, unsigned int y) {
-        glRasterPos2i(x + mWidth, y);
-        /**
-         * If you are on a retina display then you should replace the values
-         * from -1, 1 to -2, 2 to ensure they appear at full size!
-         *
-         * The PPM parser packs the image mirrored horizontally. Thus we use
-         * glPixelZoom to "flip" the image back the correct way by scaling the
-         * x axis by -1. This is the same concept as mirroring an object with
-         * glScalef(-1, 1, 1).
-         *
-         * Aside: Using the parsing code from last year. I don't think the code
-         * is very good. There is definitely a way to parse PPM bitmaps without
-         * needing to flip the image like this.
-         */
-        glPixelZoom(-1, 1);
-        glDrawPixels(mWidth, mHeight, GL_RGB, GL_UNSIGNED_BYTE, mImage);
-    }
-
-    void texture() {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, mWidth, mHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, mImage);
-        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    }
-};
-
-// 4x textures to use on the terrain
-Image marble;
-Image teapot;
-Image aerial;
-Image baboon;
+                            "Swap between a quad or a triangle mesh with the M key.\n"
+                            "Save the terrain with the P key (load it again with --load).\n"
+                            "Show and hide frame timings with the O key.\n"
+                            "Swap between timer, vsync and uncapped frame pacing with the V key.\n"
+                            "Walk on the ground instead of flying with the G key.";
+
+// decodes the 4 texture images in the background
+AssetLoader assets;
+
+// texture objects for the 4 images, in texture_mode order (texture_mode n uses slot n-1).
+// each slot stays empty (and the terrain untextured) until its image has been decoded.
+TextureManager textures;
+const char *texture_files[] = {"marble.ppm", "aerial.ppm", "teapot.ppm", "baboon.ppm"};
+
+// when the program started, for logging the time to the first frame
+std::chrono::steady_clock::time_point start_time;
+bool first_frame = true;
+
+// times each stage of every frame (and writes them to --csv if it's given)
+FrameProfiler profiler;
+// whether the timings are shown over the scene, and their text
+bool show_profile = false;
+HudText profile_text(hud_font);
+// frames since the timings' text was last rebuilt, it only changes a few times a second
+int profile_age = 0;
+const int PROFILE_REFRESH_FRAMES = 15;
 
 
 /**
@@ -166,13 +207,15 @@ void handleKeyboard(unsigned char key, int _x, int _y)
         }
         // reset terrain to regenerate
         case 'r': {
-            init_terrain();
+            // a stored terrain is whatever is in the file
+            if (!use_store) regenerate_terrain();
             break;
         }
         // swap texturing mode (none, or one of textures 1, 2, 3, 4)
         case 't': {
             texture_mode++;
             texture_mode = texture_mode % 5;
+            textures.bind(texture_mode - 1);
             if (texture_mode == 0) glDisable(GL_TEXTURE_2D);
             else glEnable(GL_TEXTURE_2D);
             break;
@@ -182,8 +225,31 @@ void handleKeyboard(unsigned char key, int _x, int _y)
             mesh = !mesh;
             break;
         }
+        // save the terrain
+        case 'p': {
+            save_terrain();
+            break;
+        }
+        // show or hide the frame timings
+        case 'o': {
+            show_profile = !show_profile;
+            profile_age = PROFILE_REFRESH_FRAMES;
+            break;
+        }
+        // cycle the frame pacing
+        case 'v': {
+            set_pacing((PacingMode)((scheduler.mode() + 1) % PACING_MODE_COUNT));
+            break;
+        }
+        // walk on the ground, or fly
+        case 'g': {
+            // a stored terrain's heights aren't all in memory to walk on
+            if (ground.ready()) ground_follow = !ground_follow;
+            break;
+        }
         // quit
         case 'q': {
+            std::cout << scheduler.missed << " frames missed their deadline" << std::endl;
             exit(0);
             break;
         }
@@ -249,28 +315,51 @@ void drawHUD() {
     // setup 2d ortho perspective
     glOrtho(-1, 1, -1, 1, -1, 1);
     glMatrixMode(GL_MODELVIEW);
-    // build a string to display
-    std::stringstream stream;
-    stream << "(" << camera.camPos.mX << "," << camera.camPos.mY << "," << camera.camPos.mZ << ")" << std::endl;
-    stream << "angles: " << camera.pitch << "," << camera.yaw << std::endl;
-    if (render_mode == 0) stream << "Filled Rendering" << std::endl;
-    else if (render_mode == 1) stream << "Wire Rendering" << std::endl;
-    else  stream << "Doubled Rendering" << std::endl;
-    if (shading) stream << "Gouraud shading" << std::endl;
-    if (lighting) stream << "Lighting enabled" << std::endl;
-
-    if (texture_mode == 0) stream << "No Textures" << std::endl;
-    else stream << "Texture " << texture_mode << std::endl;
-
-    if (mesh) stream << "Triangle Mode" << std::endl;
-    else stream << "Quads Mode" << std::endl;
-    std::string output = stream.str();
-
-    // color and position
+    // only rebuild the text when something it shows has changed
+    double values[HUD_VALUE_COUNT] = {
+        camera.camPos.mX, camera.camPos.mY, camera.camPos.mZ, camera.pitch, camera.yaw,
+        (float)render_mode, (float)shading, (float)lighting, (float)texture_mode,
+        (float)textures.loaded(texture_mode - 1), (float)mesh, (double)renderer.trianglesDrawn,
+        (double)renderer.visibleNodes, (double)store.pageIns, (double)store.residentTiles(),
+        // whole percents, so the text isn't rebuilt for every circle
+        regenerator.busy() ? floor(regenerator.progress() * 100) : -1.0,
+        (double)scheduler.mode(), (double)scheduler.missed, (double)ground_follow
+    };
+    if (hud_text.text().empty() || !std::equal(values, values + HUD_VALUE_COUNT, hud_values)) {
+        std::copy(values, values + HUD_VALUE_COUNT, hud_values);
+
+        // build a string to display
+        std::stringstream stream;
+        stream << "(" << camera.camPos.mX << "," << camera.camPos.mY << "," << camera.camPos.mZ << ")" << std::endl;
+        stream << "angles: " << camera.pitch << "," << camera.yaw << std::endl;
+        if (render_mode == 0) stream << "Filled Rendering" << std::endl;
+        else if (render_mode == 1) stream << "Wire Rendering" << std::endl;
+        else  stream << "Doubled Rendering" << std::endl;
+        if (shading) stream << "Gouraud shading" << std::endl;
+        if (lighting) stream << "Lighting enabled" << std::endl;
+
+        if (texture_mode == 0) stream << "No Textures" << std::endl;
+        else if (textures.loaded(texture_mode - 1)) stream << "Texture " << texture_mode << std::endl;
+        else stream << "Texture " << texture_mode << " (loading)" << std::endl;
+
+        if (mesh) stream << "Triangle Mode" << std::endl;
+        else stream << "Quads Mode" << std::endl;
+        stream << "Triangles: " << renderer.trianglesDrawn << std::endl;
+        stream << "Visible nodes: " << renderer.visibleNodes << "/" << renderer.nodeCount() << std::endl;
+        if (use_store) {
+            stream << "Tiles: " << store.residentTiles() << "/" << store.budgetTiles() << " resident, "
+                << store.pageIns << " page-ins" << std::endl;
+        }
+        stream << "Pacing: " << pacingModeName(scheduler.mode()) << ", " << scheduler.missed << " missed" << std::endl;
+        if (ground_follow) stream << "Walking" << std::endl;
+        if (regenerator.busy()) stream << "Generating: " << floor(regenerator.progress() * 100) << "%" << std::endl;
+        hud_text.setText(stream.str());
+    }
+
+    // color and position (the top left, where glRasterPos2f(-1, 0.9) used to put it),
+    // then write the string to the screen in one draw
     glColor4f(1.0, 0.0, 0.0, 1.0);
-    glRasterPos2f(-1, 0.9);
-    // write string to screen
-    glutBitmapString(GLUT_BITMAP_HELVETICA_18, reinterpret_cast<const unsigned char*>(output.c_str()));
+    hud_text.draw(0, screen_height * 0.95);
 
     // part 2 of hud: we want to draw a minimap as a bonus feature
     // 1. draw a gray quad to represent the region the minimap will occupy
@@ -284,27 +373,15 @@ void drawHUD() {
     glEnd();
 
     // 2. draw the terrain overview between 0.4 and 0.9 (leaving some of the grey quad visible as a border)
-    // use the x,z coords as x,y in 2d space and color according to the y coord of 3d space
-    for (int i = 0; i < x_size; i++) {
-        for (int j = 0; j < z_size; j++) {
-            float y = currentheight[i][j];
-            float green_comp = 1 - (2 * (y / max_height));
-            if (green_comp < 0) green_comp = 0;
-            float red_comp = 1 - green_comp;
-            glColor4f(red_comp, green_comp, 0, 0.8);
-            // convert (i,j) (which are coords from (0, axis_size)) into coords in (0.4, 0.9)
-            float i_p = ((float) i / (float) x_size) * 0.5;
-            float j_p = ((float) j / (float) z_size) * 0.5;
-            glBegin(GL_POINTS);
-                glVertex3f(i_p + 0.4, j_p + 0.4, 0.5);
-            glEnd();
-        }
-    }
+    // the x,z coords are x,y in 2d space and it's colored according to the y coord of 3d space
+    minimap.draw(0.4, 0.4, 0.9, 0.9, 0.8);
 
     // 3. draw a blue cross for the location of the camera, if it is on the grid
     float px = camera.camPos.mX;
     float pz = camera.camPos.mZ;
 
+    int x_size = terrain_source->xSize();
+    int z_size = terrain_source->zSize();
     if (px >= 0 && px <= x_size && pz >= 0 && pz <= z_size) {
         // translate to coords in (0.4, 0.9)
         float px_p = ((float) px / (float) x_size) * 0.5;
@@ -320,6 +397,29 @@ void drawHUD() {
         glEnd();
     }
 
+    // 4. the frame timings, a graph of the recent frames along the bottom with the breakdown above it
+    if (show_profile) {
+        profiler.drawGraph(-0.95, -0.95, 0.95, -0.75, 50);
+        if (++profile_age >= PROFILE_REFRESH_FRAMES) {
+            profile_age = 0;
+            FrameStats stats = profiler.stats();
+            std::stringstream stream;
+            stream.setf(std::ios::fixed);
+            stream.precision(2);
+            stream << "Frame: " << stats.average << "ms avg, " << stats.p50 << " p50, " << stats.p99 << " p99, "
+                << stats.worst << " worst" << std::endl;
+            for (int s = 0; s < STAGE_COUNT; s++) {
+                stream << frameStageName(s) << ": " << stats.cpu[s] << "ms";
+                if (stats.gpu[s] >= 0) stream << ", gpu " << stats.gpu[s] << "ms";
+                stream << std::endl;
+            }
+            if (!profiler.gpuTiming()) stream << "(no GPU timer queries)" << std::endl;
+            profile_text.setText(stream.str());
+        }
+        glColor4f(1.0, 1.0, 0.0, 1.0);
+        profile_text.draw(screen_width / 2, screen_height * 0.4);
+    }
+
     if(lighting) glEnable(GL_LIGHTING);
     if(texture_mode > 0) glEnable(GL_TEXTURE_2D);
 }
@@ -341,117 +441,48 @@ void motion(int x, int y)
 }
 
 /**
-* Binds a material for a vertex based on its height, as a ratio of the max height.
+* With GL_COLOR_MATERIAL the vertex color is the whole of the terrain's ambient
+* and diffuse material, where its material is only a fraction of it, so the
+* lights' ambient and diffuse are scaled by those fractions instead while it's
+* drawn. The lighting comes out the same, and the unlit colors are untouched.
+* scaled = false puts the lights back.
 */
-void bindTopographicMaterial(float y) {
-    // compute green/red components of the material
-    float green_comp = 1 - (2 * (y / max_height));
-    if (green_comp < 0) green_comp = 0;
-    float red_comp = 1 - green_comp;
-    // if lighting is enabled bind a material
-    if (lighting) {
-        float amb[4] = {((float)0.3 * red_comp), ((float)0.3 * green_comp), 0.0, 1.0};
-        float diff[4] = {((float)0.6 * red_comp), ((float)0.6 * green_comp), 0.0, 1.0};
-        float spec[4] = {((float)1.0 * red_comp), ((float)1.0 * green_comp), 0.0, 1.0};
-        float shin = 100;
-        Material(amb, diff, spec, shin).bind();
-    } else {
-        // otherwise just use glColor
-        glColor3f(red_comp, green_comp, 0.0);
+void scale_terrain_lights(bool scaled) {
+    float ambientScale = scaled ? TERRAIN_MATERIAL_AMBIENT : 1;
+    float diffuseScale = scaled ? TERRAIN_MATERIAL_DIFFUSE : 1;
+    // GL's default global ambient
+    float global[4] = {0.2f * ambientScale, 0.2f * ambientScale, 0.2f * ambientScale, 1.0};
+    glLightModelfv(GL_LIGHT_MODEL_AMBIENT, global);
+    Light *lights[2] = {&l, &l1};
+    for (int i = 0; i < 2; i++) {
+        float ambient[4], diffuse[4];
+        for (int c = 0; c < 3; c++) {
+            ambient[c] = lights[i]->ambient[c] * ambientScale;
+            diffuse[c] = lights[i]->diffuse[c] * diffuseScale;
+        }
+        ambient[3] = lights[i]->ambient[3];
+        diffuse[3] = lights[i]->diffuse[3];
+        glLightfv(lights[i]->boundLight, GL_AMBIENT, ambient);
+        glLightfv(lights[i]->boundLight, GL_DIFFUSE, diffuse);
     }
 }
 
-// fixes y-axis of a cross product, since all our vertex normals are pointing up.
-Vec3D yfix(Vec3D in) {
-    if (in.mY < 0) return Vec3D(in.mX, -in.mY, in.mZ).normalize();
-    return in.normalize();
-}
-
-// binds a normal via gl function calls
-void bindNormals(int x, int z) {
-    glNormal3f(normals[x][z].mX, normals[x][z].mY, normals[x][z].mZ);
-}
-
 /**
 * Draws the terrain from the mesh in currentheight.
 */
 void drawTerrain(bool shouldUseWire) {
     if (!shouldUseWire) {
-        // this should be replaced
-        switch (texture_mode) {
-            case 0: {
-                glBindTexture(GL_TEXTURE_2D, 0);
-                break;
-            }
-            case 1: {
-                marble.texture();
-                break;
-            }
-            case 2: {
-                aerial.texture();
-                break;
-            }
-            case 3: {
-                teapot.texture();
-                break;
-            }
-            case 4: {
-                baboon.texture();
-                break;
-            }
-        }
-
-        for (int x = 0; x < (x_size-1); x++) {
-            for (int z = 0; z < (z_size-1); z++) {
-                // for each vertex, render it and bind a material for it
-                if(!mesh){
-                    glBegin(GL_QUADS);
-                        bindTopographicMaterial(currentheight[0+x][1+z]);
-                        glTexCoord2f(0, 0);
-                        bindNormals(x, z+1);
-                        glVertex3f(0+x, currentheight[0+x][1+z], 1+z);
-
-                        bindTopographicMaterial(currentheight[1+x][1+z]);
-                        glTexCoord2f(1, 0);
-                        bindNormals(x+1, z+1);
-                        glVertex3f(1+x, currentheight[1+x][1+z], 1+z);
-
-                        bindTopographicMaterial(currentheight[1+x][0+z]);
-                        glTexCoord2f(1, 1);
-                        bindNormals(x+1, z);
-                        glVertex3f(1+x, currentheight[1+x][0+z], 0+z);
-
-                        bindTopographicMaterial(currentheight[0+x][0+z]);
-                        glTexCoord2f(0, 1);
-                        bindNormals(x, z);
-                        glVertex3f(0+x, currentheight[0+x][0+z], 0+z);
-                    glEnd();
-                }
-                else{
-                    glBegin(GL_TRIANGLE_STRIP);
-                        bindTopographicMaterial(currentheight[0+x][0+z]);
-                        glTexCoord2f(0, 0);
-                        bindNormals(x, z);
-                        glVertex3f(0+x, currentheight[0+x][0+z], 0+z);
-
-                        bindTopographicMaterial(currentheight[0+x][1+z]);
-                        glTexCoord2f(0, 1);
-                        bindNormals(x, z+1);
-                        glVertex3f(0+x, currentheight[0+x][1+z], 1+z);
-
-                        bindTopographicMaterial(currentheight[1+x][0+z]);
-                        glTexCoord2f(1, 0);
-                        bindNormals(x+1, z);
-                        glVertex3f(1+x, currentheight[1+x][0+z], 0+z);
-
-                        bindTopographicMaterial(currentheight[1+x][1+z]);
-                        glTexCoord2f(1, 1);
-                        bindNormals(x+1, z+1);
-                        glVertex3f(1+x, currentheight[1+x][1+z], 1+z);
-                    glEnd();
-                }
-            }
-        }
+        // ambient and diffuse come from the vertex colors, this sets the highlights. they
+        // can't follow the vertex color too (GL_COLOR_MATERIAL tracks one color), so they
+        // are the average of the original green to red ramp
+        float amb[4] = {0.0, 0.0, 0.0, 1.0};
+        float diff[4] = {0.0, 0.0, 0.0, 1.0};
+        float spec[4] = {0.5, 0.5, 0.0, 1.0};
+        float shin = 100;
+        Material(amb, diff, spec, shin).bind();
+        if (lighting) scale_terrain_lights(true);
+        renderer.draw(mesh, false);
+        if (lighting) scale_terrain_lights(false);
     } else {
         // if 'shouldUseWire' is true we use a blue material instead
         // so the wires are visible against the filled terrain
@@ -462,57 +493,143 @@ void drawTerrain(bool shouldUseWire) {
         float spec[4] = {0.0, 0.0, 1.0, 1.0};
         float shin = 100;
         Material(amb, diff, spec, shin).bind();
-        for (int x = 0; x < (x_size-1); x++) {
-            for (int z = 0; z < (z_size-1); z++) {
-                // for each vertex, render it and bind a material for it
-                if(!mesh){
-                    glBegin(GL_QUADS);
-                        glTexCoord2f(0, 0);
-                        bindNormals(x, z+1);
-                        glVertex3f(0+x, currentheight[0+x][1+z], 1+z);
-
-                        glTexCoord2f(1, 0);
-                        bindNormals(x+1, z+1);
-                        glVertex3f(1+x, currentheight[1+x][1+z], 1+z);
-
-                        glTexCoord2f(1, 1);
-                        bindNormals(x+1, z);
-                        glVertex3f(1+x, currentheight[1+x][0+z], 0+z);
-
-                        glTexCoord2f(0, 1);
-                        bindNormals(x, z);
-                        glVertex3f(0+x, currentheight[0+x][0+z], 0+z);
-                    glEnd();
-                }
-                else{
-                    glBegin(GL_TRIANGLE_STRIP);
-                        glTexCoord2f(0, 0);
-                        bindNormals(x, z);
-                        glVertex3f(0+x, currentheight[0+x][0+z], 0+z);
-
-                        glTexCoord2f(0, 1);
-                        bindNormals(x, z+1);
-                        glVertex3f(0+x, currentheight[0+x][1+z], 1+z);
-
-                        glTexCoord2f(1, 0);
-                        bindNormals(x+1, z);
-                        glVertex3f(1+x, currentheight[1+x][0+z], 0+z);
-
-                        glTexCoord2f(1, 1);
-                        bindNormals(x+1, z+1);
-                        glVertex3f(1+x, currentheight[1+x][1+z], 1+z);
-                    glEnd();
-                }
+        renderer.draw(mesh, true);
+    }
+}
+
+
+/**
+* Uploads any textures that have finished decoding since the last frame.
+* Has to run on the GL thread.
+*/
+void uploadDecodedTextures() {
+    int slot;
+    DecodedImage image;
+    while (assets.poll(slot, image)) {
+        if (!image.pixels) {
+            std::cout << "could not load " << image.file << ": " << image.error << std::endl;
+            continue;
+        }
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        textures.upload(slot, image.pixels, image.width, image.height);
+        double uploadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "decoded " << image.file << " in " << image.decodeMs << "ms, uploaded in " << uploadMs << "ms" << std::endl;
+        free(image.pixels);
+
+        // the texture we're meant to be showing just arrived
+        if (slot == texture_mode - 1) textures.bind(slot);
+    }
+}
+
+/**
+* Moves everything on to the time of the frame about to be drawn. Movement
+* runs in the scheduler's fixed steps and is drawn interpolated between the
+* last two, looking around follows the mouse every frame, and the rise
+* animation is timed from when it started.
+*/
+void update_simulation()
+{
+    // applies rotations
+    camera.applyRotation();
+
+    int steps = scheduler.beginFrame();
+    for (int s = 0; s < steps; s++) {
+        camera_prev = camera_next;
+        camera.camPos = camera_next;
+        // apply movement for each of the input keys
+        for (int i = 0; i < 4; i++) {
+            if (movement[i]) {
+                camera.applyMovement(i, CAMERA_STEP);
             }
         }
+        // the final heights, so the camera is never under the terrain as it rises
+        if (ground_follow && ground.contains(camera.camPos.mX, camera.camPos.mZ)) {
+            camera.camPos.mY = ground.height(camera.camPos.mX, camera.camPos.mZ) + EYE_HEIGHT;
+        }
+        camera_next = camera.camPos;
+    }
+    float alpha = scheduler.alpha();
+    camera.camPos = Vec3D(camera_prev.mX + (camera_next.mX - camera_prev.mX) * alpha,
+                          camera_prev.mY + (camera_next.mY - camera_prev.mY) * alpha,
+                          camera_prev.mZ + (camera_next.mZ - camera_prev.mZ) * alpha);
+
+    // raise the terrain towards its actual heights, until it has all got there
+    if (!rise.settled()) {
+        ScopedTimer timer(profiler, STAGE_RISE);
+        rise.advance(terrain, std::chrono::duration<double>(std::chrono::steady_clock::now() - rise_start).count());
     }
 }
 
+/**
+* Timer for the next frame in timer pacing.
+*/
+void pace(int val)
+{
+    frame_pending = false;
+    glutPostRedisplay();
+}
 
 /**
-* Display function
+* Asks for the next frame: straight away when drawing back to back, otherwise
+* when it's due, less however long this one took.
 */
-void display()
+void schedule_next_frame()
+{
+    if (scheduler.mode() != PACING_TIMER) {
+        glutPostRedisplay();
+    } else if (!frame_pending) {
+        // display can be called for other reasons (like the window being uncovered),
+        // so there's only ever one timer waiting
+        frame_pending = true;
+        glutTimerFunc(scheduler.delayMs(), pace, 0);
+    }
+}
+
+// switches the frame pacing, syncing buffer swaps to the display only for vsync
+void set_pacing(PacingMode mode)
+{
+    scheduler.setMode(mode);
+    if (!setSwapInterval(mode == PACING_VSYNC ? 1 : 0)) {
+        std::cout << "can't change the swap interval on this platform" << std::endl;
+    }
+    std::cout << "frame pacing: " << pacingModeName(mode) << std::endl;
+    schedule_next_frame();
+}
+
+/**
+* Uploads whatever changed in the terrain since the last frame: all of it after
+* it's generated, then just the parts the rise animation moved.
+* The minimap takes up a quarter of the screen's width and height.
+*/
+void upload_terrain()
+{
+    TerrainRegion dirty_bounds;
+    if (terrain_changed && use_store) {
+        renderer.update(store_source);
+        minimap.update(store_overview, store.max_height, renderer.ramp, screen_width / 4, screen_height / 4,
+            0, 0, store_overview.x_size, store_overview.z_size);
+        terrain_changed = false;
+    } else if (terrain_changed) {
+        renderer.update(state_source);
+        minimap.update(terrain, renderer.ramp, screen_width / 4, screen_height / 4);
+        // everything was just uploaded
+        rise.takeDirty(dirty_regions, dirty_bounds);
+        terrain_changed = false;
+    } else if (rise.takeDirty(dirty_regions, dirty_bounds)) {
+        // only the parts that are still rising
+        for (size_t i = 0; i < dirty_regions.size(); i++) {
+            renderer.update(state_source, dirty_regions[i].x0, dirty_regions[i].x1 - dirty_regions[i].x0);
+        }
+        minimap.update(terrain, renderer.ramp, screen_width / 4, screen_height / 4,
+            dirty_bounds.x0, dirty_bounds.z0, dirty_bounds.x1, dirty_bounds.z1);
+    }
+}
+
+/**
+* Draws the scene from the camera into whatever framebuffer is bound, with
+* the HUD over it if hud is set. Shared by the window and headless rendering.
+*/
+void render_scene(bool hud)
 {
     // set up camera perspective and point it at the looking point
     camera.setupPerspective();
@@ -520,6 +637,31 @@ void display()
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     camera.lookAt();
 
+    // pick up any textures that finished loading
+    if (!assets.finished()) uploadDecodedTextures();
+
+    // swap in a terrain that finished generating in the background. it only happens
+    // here, before anything reads the terrain for this frame
+    if (regenerator.take(terrain)) {
+        std::cout << "generated a new terrain (seed " << terrain.seed << ") in "
+            << regenerator.timings.total() << "ms" << std::endl;
+        rise.start(terrain, rise_duration);
+        rise_start = std::chrono::steady_clock::now();
+        terrain_changed = true;
+        ground.build(terrain.heightmap);
+    }
+
+    // upload the terrain if it changed since the last frame
+    {
+        ScopedTimer timer(profiler, STAGE_UPLOAD, true);
+        upload_terrain();
+    }
+
+    // skip the parts of the terrain outside the view, and pick how detailed
+    // the rest is from where it's seen
+    renderer.cull(Frustum(camera.camPos, camera.camFront, camera.up, camera.fov, camera.aspect, camera.nearPlane, camera.farPlane));
+    renderer.selectLevels(*terrain_source, camera.camPos, camera.fov, screen_height);
+
     // only render the lights if lighting is enabled
     if (lighting) {
         l.render();
@@ -527,172 +669,341 @@ void display()
     }
 
     // draw the terrain
-    if (render_mode == 0) {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        drawTerrain(false);
-    } else if (render_mode == 1) {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        drawTerrain(false);
-    } else if (render_mode == 2) {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        drawTerrain(false);
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        drawTerrain(true);
+    {
+        ScopedTimer timer(profiler, STAGE_TERRAIN, true);
+        if (render_mode == 0) {
+            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+            drawTerrain(false);
+        } else if (render_mode == 1) {
+            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+            drawTerrain(false);
+        } else if (render_mode == 2) {
+            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+            drawTerrain(false);
+            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+            drawTerrain(true);
+        }
     }
 
     // draw a 2d HUD
-    drawHUD();
+    if (hud) {
+        ScopedTimer timer(profiler, STAGE_HUD, true);
+        drawHUD();
+    }
+}
+
+/**
+* Display function
+*/
+void display()
+{
+    profiler.beginFrame();
+    update_simulation();
+
+    // the font is rasterized into the back buffer, so it has to happen before anything is drawn
+    if (first_frame) hud_font.build(GLUT_BITMAP_HELVETICA_18);
+
+    render_scene(true);
 
     // swap buffers
-    glutSwapBuffers();
+    {
+        ScopedTimer timer(profiler, STAGE_SWAP);
+        glutSwapBuffers();
+    }
+    profiler.endFrame();
+    scheduler.endFrame();
+    schedule_next_frame();
+
+    if (first_frame) {
+        first_frame = false;
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+        std::cout << "time to first frame: " << ms << "ms" << std::endl;
+    }
 }
 
-// used to dynamically animate the height of the terrain
-// (so it raises to its actual height after generation)
-void updateHeights() {
-    for (int x = 0; x < x_size; x++) {
-        for (int z = 0; z < z_size; z++) {
-            if (currentheight[x][z] < heightmap[x][z]) {
-                currentheight[x][z] += 0.01;
-            }
-        }
+// generates a new heightmap
+void init_terrain(int x_size, int z_size) {
+    std::cout << "generating terrain with seed " << seed << std::endl;
+    generator.generate(terrain, x_size, z_size, seed++);
+    // start it flat and animate it rising to its actual heights
+    rise.start(terrain, rise_duration);
+    rise_start = std::chrono::steady_clock::now();
+    terrain_changed = true;
+    ground.build(terrain.heightmap);
+}
+
+// starts generating a new heightmap of the same size in the background,
+// the current one keeps being drawn until it's ready
+void regenerate_terrain() {
+    if (regenerator.start(terrain.x_size, terrain.z_size, seed)) seed++;
+}
+
+// saves the terrain to terrain_<seed>.thc
+void save_terrain() {
+    // a stored terrain is already on disk
+    if (use_store) return;
+    std::stringstream filename;
+    filename << "terrain_" << terrain.seed << ".thc";
+    const char *error = NULL;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (!saveTerrain(terrain, filename.str().c_str(), false, &error)) {
+        std::cout << "could not save " << filename.str() << ": " << error << std::endl;
+        return;
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "saved " << filename.str() << " in " << ms << "ms" << std::endl;
+}
+
+// loads a saved heightmap, which rises just like a generated one
+bool load_terrain(const char *file) {
+    const char *error = NULL;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (!loadTerrain(terrain, file, &error)) {
+        std::cout << "could not load " << file << ": " << error << std::endl;
+        return false;
     }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "loaded " << file << " (seed " << terrain.seed << ") in " << ms << "ms" << std::endl;
+    seed = terrain.seed + 1;
+    rise.start(terrain, rise_duration);
+    rise_start = std::chrono::steady_clock::now();
+    terrain_changed = true;
+    ground.build(terrain.heightmap);
+    return true;
 }
 
 /**
-* FPS timing function to lock program to around 60fps
+* Sets up the GL state the scene is drawn with, in the window or headless.
+* The lights are placed from the size of the terrain.
 */
-void FPS(int val)
+void init_gl(int x_size, int z_size)
 {
-    // applies rotations
-    camera.applyRotation();
-    // apply movement for each of the input keys
-    for (int i = 0; i < 4; i++) {
-        if (movement[i]) {
-            camera.applyMovement(i, 0.5);
-        }
-    }
+    // set screen clear color to black
+    glClearColor(0.0, 0.0, 0.0, 1.0);
 
-    // update heights if needed
-    updateHeights();
+    // enable smooth shading
+    glShadeModel(GL_SMOOTH);
 
-    glutPostRedisplay();
-    glutTimerFunc(17, FPS, val);
-}
+    // depth test/face culling
+    glEnable(GL_DEPTH_TEST);
+    glCullFace(GL_BACK);
+    glEnable(GL_CULL_FACE);
 
-// circle terrain generation algorithm
-void terrain(int tx, int tz, float disp) {
-    Point3D center = Point3D(tx, 0, tz);
-    float terrainCircleSize = (x_size + z_size) / 20;
-    for (int i = 0; i < x_size; i++) {
-        for (int j = 0; j < z_size; j++) {
-            float pd = (center.distanceTo(Point3D(i, 0, j)) * 2) / terrainCircleSize;
-            if (fabs(pd) <= 1.0) {
-                heightmap[i][j] += disp/2 + (cos(pd*3.14)*disp)/2;
-                if (heightmap[i][j] > max_height) max_height = heightmap[i][j];
-            }
-        }
-    }
+    glEnable(GL_TEXTURE_2D);
+
+    // one slot per image, each is uploaded once when it's decoded.
+    // switching textures after that is just a bind
+    textures.reserve(4);
+
+    // light properties, shared with the ray marcher
+    SceneLight lights[SCENE_LIGHT_COUNT];
+    sceneLights(x_size, z_size, lights);
+    l = Light(GL_LIGHT0, lights[0].position, lights[0].ambient, lights[0].diffuse, lights[0].specular);
+    l1 = Light(GL_LIGHT1, lights[1].position, lights[1].ambient, lights[1].diffuse, lights[1].specular);
+
+    glEnable(GL_LIGHTING);
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 }
 
-// generates a new heightmap
-void init_terrain() {
-    delete[] heightmap;
-    delete[] currentheight;
-    delete[] normals;
+/**
+* Points the camera from a viewpoint's eye at its target, the way the mouse
+* would have turned it.
+*/
+void set_viewpoint(const Viewpoint &point)
+{
+    camera.camPos = point.eye;
+    camera.camFront = Vec3D(point.target.mX - point.eye.mX, point.target.mY - point.eye.mY,
+                            point.target.mZ - point.eye.mZ).normalize();
+    camera.pitch = asin(camera.camFront.mY) * 180 / M_PI;
+    camera.yaw = atan2(camera.camFront.mZ, camera.camFront.mX) * 180 / M_PI;
+}
 
-    // initialize first dimension for heightmap
-    heightmap = new float*[x_size];
-    for (int i = 0; i < x_size; i++) {
-        // initialize second dimension for heightmap
-        heightmap[i] = new float[z_size];
-        for (int j = 0; j < z_size; j++) {
-            heightmap[i][j] = 0;
+/**
+* Renders frames along a camera path into an offscreen context, with no
+* window, writing each to <prefix><frame>.ppm. Without a path file the camera
+* orbits the terrain. Each frame is read back while the next one is drawn
+* (see FrameCapture), and the frame rate is reported at the end.
+*/
+int run_headless(const char *prefix, const char *path_file, int frames)
+{
+    OffscreenContext context;
+    const char *error = NULL;
+    if (!context.create(screen_width, screen_height, &error)) {
+        std::cout << "could not create an offscreen context: " << error << std::endl;
+        return -1;
+    }
+    std::cout << "rendering " << screen_width << "x" << screen_height << " offscreen on " << context.renderer() << std::endl;
+    if (!loadGLExtensions()) {
+        std::cout << "OpenGL 1.5 or newer is required" << std::endl;
+        return -1;
+    }
+    profiler.initGpu();
+
+    int x_size = terrain_source->xSize();
+    int z_size = terrain_source->zSize();
+    init_gl(x_size, z_size);
+    CameraPath path;
+    if (path_file) {
+        if (!path.load(path_file, &error)) {
+            std::cout << "could not load camera path " << path_file << ": " << error << std::endl;
+            return -1;
         }
+        // one frame per viewpoint unless asked for more
+        if (frames <= 0) frames = path.points.size();
+    } else {
+        if (frames <= 0) frames = 120;
+        path.setOrbit(x_size, z_size, frames);
     }
 
-    // initialize first dimension for currentheight
-    currentheight = new float*[x_size];
-    for (int i = 0; i < x_size; i++) {
-        // initialize second dimension for currentheight
-        currentheight[i] = new float[z_size];
-        for (int j = 0; j < z_size; j++) {
-            currentheight[i][j] = 0;
+    // previews show the finished terrain, not the start of it rising
+    if (!use_store) rise.advance(terrain, rise_duration);
+
+    FrameCapture capture;
+    capture.start(screen_width, screen_height, prefix);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++) {
+        profiler.beginFrame();
+        set_viewpoint(path.at(frames > 1 ? (float)i / (frames - 1) : 0));
+        render_scene(false);
+        {
+            ScopedTimer timer(profiler, STAGE_SWAP);
+            capture.capture(i);
         }
+        profiler.endFrame();
+    }
+    double renderMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    capture.finish();
+    double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    FrameStats stats = profiler.stats();
+    std::cout << "rendered " << frames << " frames in " << renderMs << "ms, " << frames * 1000 / renderMs << "fps ("
+        << stats.p50 << "ms p50, " << stats.p99 << "ms p99)" << std::endl;
+    std::cout << "waited " << capture.waitMs << "ms for read backs, the writer took " << capture.writeMs
+        << "ms, all written after " << totalMs << "ms" << std::endl;
+    if (capture.failed > 0) {
+        std::cout << "could not write " << capture.failed << " frames to " << prefix << "*.ppm" << std::endl;
+        return -1;
     }
+    return 0;
+}
 
-    // initialize first dimension for normals
-    normals = new Vec3D*[x_size];
-    for (int i = 0; i < x_size; i++) {
-        // initialize second dimension for normals
-        normals[i] = new Vec3D[z_size];
-        for (int j = 0; j < z_size; j++) {
-            normals[i][j] = Vec3D();
+int main(int argc, char** argv)
+{
+    start_time = std::chrono::steady_clock::now();
+    seed = time(NULL);
+    // --store, --load, --budget, --seed, --csv, --pacing and the headless options can go anywhere,
+    // everything else is positional
+    std::vector<const char*> args;
+    const char *store_file = NULL;
+    const char *load_file = NULL;
+    // every frame's timings are written here, if it's given
+    const char *csv_file = NULL;
+    PacingMode pacing = PACING_TIMER;
+    // with --headless there's no window, frames are rendered offscreen to <prefix><frame>.ppm
+    // along --path (or an orbit), --frames of them
+    const char *headless_prefix = NULL;
+    const char *path_file = NULL;
+    int frames = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--store") == 0 && i + 1 < argc) store_file = argv[++i];
+        else if (strcmp(argv[i], "--load") == 0 && i + 1 < argc) load_file = argv[++i];
+        else if (strcmp(argv[i], "--budget") == 0 && i + 1 < argc) store_budget = atof(argv[++i]);
+        else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc) csv_file = argv[++i];
+        else if (strcmp(argv[i], "--pacing") == 0 && i + 1 < argc) {
+            int mode = pacingModeFromName(argv[++i]);
+            if (mode < 0) {
+                std::cout << "pacing must be timer, vsync or uncapped" << std::endl;
+                return -1;
+            }
+            pacing = (PacingMode)mode;
         }
+        else if (strcmp(argv[i], "--headless") == 0 && i + 1 < argc) headless_prefix = argv[++i];
+        else if (strcmp(argv[i], "--path") == 0 && i + 1 < argc) path_file = argv[++i];
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) frames = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &screen_width, &screen_height) != 2 || screen_width < 1 || screen_height < 1) {
+                std::cout << "size must be <width>x<height>" << std::endl;
+                return -1;
+            }
+        }
+        // the same seed always gives the same terrain, so a run can be repeated
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) seed = strtoul(argv[++i], NULL, 10);
+        else args.push_back(argv[i]);
     }
 
-    // do 1000 iterations of terrain algorithm
-    float disp = (x_size+z_size) / 80;
-    for (int i = 0; i < (x_size+z_size)*2.5; i++) {
-        int tx = 0 + (rand() % static_cast<int>(x_size + 1));
-        int tz = 0 + (rand() % static_cast<int>(z_size + 1));
-        terrain(tx, tz, disp);
-        disp /= 1.0005;
+    // the picture is the shape of the screen
+    camera.aspect = (float)screen_width / screen_height;
+
+    // input for x and z size, unless the terrain comes from a file
+    size_t sizes = store_file || load_file ? 0 : 2;
+    if (args.size() != sizes && args.size() != sizes + 1) {
+        std::cout << "usage: " << argv[0] << " <x_size> <z_size> [--seed <seed>] [color ramp file]" << std::endl;
+        std::cout << "       (any of them can also take --csv <file> to write every frame's timings," << std::endl;
+        std::cout << "       and --pacing timer|vsync|uncapped)" << std::endl;
+        std::cout << "       (or --headless <output prefix> [--path <viewpoints file>] [--frames <n>] [--size <w>x<h>]" << std::endl;
+        std::cout << "       to render frames to images without a window)" << std::endl;
+        std::cout << "       " << argv[0] << " --load <saved terrain> [color ramp file]" << std::endl;
+        std::cout << "       " << argv[0] << " --store <tiled heightmap> [--budget <MB>] [color ramp file]" << std::endl;
+        return -1;
     }
 
-    // compute the maximum height in use
-    for (int i = 0; i < x_size; i++) {
-        for (int j = 0; j < z_size; j++) {
-            if (heightmap[i][j] > max_height) max_height = heightmap[i][j];
+    // the default ramp is the topographic one, a file can replace it
+    if (args.size() == sizes + 1) {
+        const char *error = NULL;
+        if (!renderer.ramp.load(args[sizes], &error)) {
+            std::cout << "could not load color ramp " << args[sizes] << ": " << error << std::endl;
+            return -1;
         }
     }
 
-    // iterate over each index and compute average vertex normal from all intersections
-    for (int i = 0; i < x_size; i++) {
-        for (int j = 0; j < z_size; j++) {
-            Vec3D up = Vec3D();
-            Vec3D down = Vec3D();
-            Vec3D left = Vec3D();
-            Vec3D right = Vec3D();
-
-            // compute vectors along grid lines if present
-            if (i+1 < x_size) right = Vec3D(1, heightmap[i+1][j] - heightmap[i][j], 0);
-            if (i-1 >= 0) left = Vec3D(-1, heightmap[i-1][j] - heightmap[i][j], 0);
-            if (j+1 < z_size) up = Vec3D(0, heightmap[i][j+1] - heightmap[i][j], 1);
-            if (j-1 >= 0) down = Vec3D(0, heightmap[i][j-1] - heightmap[i][j], -1);
-
-            // compute cross products
-            Vec3D ur = yfix(up.cross(right));
-            Vec3D rd = yfix(right.cross(down));
-            Vec3D dl = yfix(down.cross(left));
-            Vec3D lu = yfix(left.cross(up));
-
-            // average of vectors
-            Vec3D fin = Vec3D((ur.mX + rd.mX + dl.mX + lu.mX) / 4, (ur.mY + rd.mY + dl.mY + lu.mY) / 4, (ur.mZ + rd.mZ + dl.mZ + lu.mZ) / 4).normalize();
+    // start decoding the textures in the background, they're picked up as they finish
+    // (headless frames are untextured)
+    for (int i = 0; headless_prefix == NULL && i < 4; i++) {
+        assets.load(texture_files[i]);
+    }
 
-            // store
-            normals[i][j] = fin;
+    int x_size, z_size;
+    if (store_file) {
+        const char *error = NULL;
+        if (!store.open(store_file, false, &error)) {
+            std::cout << "could not open " << store_file << ": " << error << std::endl;
+            return -1;
         }
+        store.setBudget((size_t)(store_budget * 1024 * 1024));
+        x_size = store.x_size;
+        z_size = store.z_size;
+
+        // the minimap only needs the highest point under each of its texels
+        int level = 0;
+        while (((x_size - 1) >> level) + 1 > screen_width / 4 || ((z_size - 1) >> level) + 1 > screen_height / 4) level++;
+        store.downsample(level, store_overview);
+
+        use_store = true;
+        terrain_source = &store_source;
+        terrain_changed = true;
+        std::cout << store_file << ": " << x_size << "x" << z_size << ", " << store.tilesX * store.tilesZ
+            << " tiles, keeping up to " << store.budgetTiles() << " in memory" << std::endl;
+    } else if (load_file) {
+        if (!load_terrain(load_file)) return -1;
+        x_size = terrain.x_size;
+        z_size = terrain.z_size;
+    } else {
+        x_size = atoi(args[0]);
+        z_size = atoi(args[1]);
+        init_terrain(x_size, z_size);
     }
-}
 
-int main(int argc, char** argv)
-{
-    srand(time(NULL));
-    // input for x and z size
-    if (argc != 3) {
-        std::cout << "not enough arguments" << std::endl;
+    // the camera hasn't taken any steps yet
+    camera_prev = camera_next = camera.camPos;
+
+    if (csv_file && !profiler.openCsv(csv_file)) {
+        std::cout << "could not open " << csv_file << std::endl;
         return -1;
     }
-    x_size = atoi(argv[1]);
-    z_size = atoi(argv[2]);
 
-    init_terrain();
-
-    marble.load("marble.ppm");
-    aerial.load("aerial.ppm");
-    teapot.load("teapot.ppm");
-    baboon.load("baboon.ppm");
+    if (headless_prefix) return run_headless(headless_prefix, path_file, frames);
 
     std::cout << instructions << std::endl;
 
@@ -703,41 +1014,19 @@ int main(int argc, char** argv)
     glutInitWindowPosition(0, 0);
     glutCreateWindow("A4 - Terrain");
 
-    // disable cursor (seems not to work on unix systems)
-    glutSetCursor(GLUT_CURSOR_NONE);
-
-    // set screen clear color to black
-    glClearColor(0.0, 0.0, 0.0, 1.0);
-
-    // enable smooth shading
-    glShadeModel(GL_SMOOTH);
-
-    // depth test/face culling
-    glEnable(GL_DEPTH_TEST);
-    glCullFace(GL_BACK);
-    glEnable(GL_CULL_FACE);
-
-    glEnable(GL_TEXTURE_2D);
-
-    // light properties
-    float pos[4] = {0, ((float)(x_size+z_size) / 80) + 10, 0, 1};
-    float pos2[4] = {(float)x_size, ((float)(x_size+z_size) / 80) + 10, (float)z_size, 1};
-
-    float amb[4] = {0.3, 0.3, 0.3, 1.0};
-    float diff[4] = {0.7, 0.7, 0.7, 1.0};
-    float spec[4] = {1.0, 1.0, 1.0, 1.0};
-
-    float amb2[4] = {0.3, 0.3, 0.3, 1.0};
-    float diff2[4] = {0.5, 0.5, 0.5, 1.0};
-    float spec2[4] = {0.7, 0.7, 0.7, 1.0};
+    // buffer objects need GL 1.5
+    if (!loadGLExtensions()) {
+        std::cout << "OpenGL 1.5 or newer is required" << std::endl;
+        return -1;
+    }
 
-    l = Light(GL_LIGHT0, pos, amb, diff, spec);
-    l1 = Light(GL_LIGHT1, pos2, amb2, diff2, spec2);
+    // time the stages of each frame on the GPU too, if the driver can
+    profiler.initGpu();
 
-    glEnable(GL_LIGHTING);
+    // disable cursor (seems not to work on unix systems)
+    glutSetCursor(GLUT_CURSOR_NONE);
 
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    init_gl(x_size, z_size);
 
     // callbacks
     glutKeyboardFunc(handleKeyboard);
@@ -747,10 +1036,10 @@ int main(int argc, char** argv)
     glutMotionFunc(motion);
     glutPassiveMotionFunc(motion);
     glutDisplayFunc(display);
-    glutTimerFunc(0, FPS, 0);
+    set_pacing(pacing);
 
     // kick off main loop
     glutMainLoop();
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,73 @@
+#include "assetLoader.h"
+#include <cstdlib>
+#include <chrono>
+
+AssetLoader::AssetLoader() {}
+
+AssetLoader::~AssetLoader() {
+	this->join();
+	for (size_t i = 0; i < this->assets.size(); i++) {
+		// free anything that was decoded but never taken
+		if (!this->assets[i]->taken) free(this->assets[i]->image.pixels);
+		delete this->assets[i];
+	}
+}
+
+/**
+* Runs on the asset's own thread.
+*/
+void AssetLoader::decode(Asset *asset) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	asset->image.pixels = LoadPPM(asset->image.file.c_str(), &asset->image.width, &asset->image.height, &asset->image.error);
+	asset->image.decodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	// publish the image to the GL thread
+	asset->done.store(true, std::memory_order_release);
+}
+
+/**
+* Starts decoding a file in the background.
+*/
+int AssetLoader::load(const std::string &file) {
+	Asset *asset = new Asset();
+	asset->image.file = file;
+	asset->image.pixels = NULL;
+	asset->image.width = 0;
+	asset->image.height = 0;
+	asset->image.error = NULL;
+	asset->image.decodeMs = 0;
+	asset->done.store(false);
+	asset->taken = false;
+	this->assets.push_back(asset);
+	asset->thread = std::thread(decode, asset);
+	return this->assets.size() - 1;
+}
+
+/**
+* Hands back one finished image, if there are any.
+*/
+bool AssetLoader::poll(int &index, DecodedImage &image) {
+	for (size_t i = 0; i < this->assets.size(); i++) {
+		Asset *asset = this->assets[i];
+		if (asset->taken || !asset->done.load(std::memory_order_acquire)) continue;
+		// the thread has finished its work, so this won't block
+		asset->thread.join();
+		asset->taken = true;
+		index = i;
+		image = asset->image;
+		return true;
+	}
+	return false;
+}
+
+bool AssetLoader::finished() {
+	for (size_t i = 0; i < this->assets.size(); i++) {
+		if (!this->assets[i]->taken) return false;
+	}
+	return true;
+}
+
+void AssetLoader::join() {
+	for (size_t i = 0; i < this->assets.size(); i++) {
+		if (this->assets[i]->thread.joinable()) this->assets[i]->thread.join();
+	}
+}
@@ -0,0 +1,66 @@
+#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+
+#include "PPM.h"
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+/**
+* An image decoded by the AssetLoader.
+* If decoding failed pixels is NULL and error says why.
+*/
+struct DecodedImage {
+	std::string file;
+	GLubyte *pixels;
+	int width;
+	int height;
+	const char *error;
+	// wall time spent decoding, in ms
+	double decodeMs;
+};
+
+/**
+* Decodes images on background threads, one thread per image, so they load
+* in parallel without holding up the window. Nothing here touches GL: the
+* GL thread polls for finished images and uploads them itself.
+*/
+class AssetLoader {
+public:
+	AssetLoader();
+	~AssetLoader();
+
+	// starts decoding an image on its own thread, returns its index
+	int load(const std::string &file);
+
+	// takes an image that has finished decoding and hasn't been taken yet.
+	// returns false if none are ready. the pixels are the caller's to free.
+	bool poll(int &index, DecodedImage &image);
+
+	// true once every image has been taken
+	bool finished();
+
+	// waits for all of the decoding threads
+	void join();
+
+private:
+	// the loader owns threads, so it can't be copied
+	AssetLoader(const AssetLoader &other);
+	AssetLoader &operator=(const AssetLoader &other);
+
+	struct Asset {
+		DecodedImage image;
+		std::thread thread;
+		// set by the decoding thread once image is filled in
+		std::atomic<bool> done;
+		bool taken;
+	};
+
+	// decodes a single image, runs on the asset's thread
+	static void decode(Asset *asset);
+
+	std::vector<Asset*> assets;
+};
+
+#endif
@@ -0,0 +1,44 @@
+#include "backgroundGenerator.h"
+
+BackgroundGenerator::BackgroundGenerator() {
+	this->running = false;
+	this->done.store(false);
+}
+
+/**
+* Doesn't wait for a terrain nobody will take: the generator is stopped at
+* its next progress update.
+*/
+BackgroundGenerator::~BackgroundGenerator() {
+	this->generator.cancelled.store(true);
+	if (this->thread.joinable()) this->thread.join();
+}
+
+/**
+* Runs on the worker thread.
+*/
+void BackgroundGenerator::run(BackgroundGenerator *self, int x_size, int z_size, unsigned int seed) {
+	self->generator.generate(self->next, x_size, z_size, seed);
+	// publish the terrain to the GL thread
+	self->done.store(true, std::memory_order_release);
+}
+
+bool BackgroundGenerator::start(int x_size, int z_size, unsigned int seed) {
+	if (this->running) return false;
+	this->running = true;
+	this->done.store(false);
+	// so the last terrain's progress isn't shown before the thread gets going
+	this->generator.progress.store(0);
+	this->thread = std::thread(run, this, x_size, z_size, seed);
+	return true;
+}
+
+bool BackgroundGenerator::take(TerrainState &state) {
+	if (!this->running || !this->done.load(std::memory_order_acquire)) return false;
+	// the thread has finished its work, so this won't block
+	this->thread.join();
+	state.swap(this->next);
+	this->timings = this->generator.timings;
+	this->running = false;
+	return true;
+}
@@ -0,0 +1,58 @@
+#ifndef BACKGROUND_GENERATOR_H
+#define BACKGROUND_GENERATOR_H
+
+#include "terrainGenerator.h"
+#include <thread>
+#include <atomic>
+
+/**
+* Generates terrains on a worker thread, into a state of its own, so the
+* window keeps drawing the old terrain while the new one is built.
+*
+* The finished terrain is handed over by swapping it with the one being
+* drawn (see TerrainState::swap), which only moves the grids' pointers. The
+* GL thread does that between frames, so it never sees a half-built grid,
+* and the old terrain's grids become the buffer the next one is built in.
+*/
+class BackgroundGenerator {
+public:
+	BackgroundGenerator();
+	~BackgroundGenerator();
+
+	// starts generating a terrain of the given size from seed.
+	// returns false (and does nothing) if one is already being generated.
+	bool start(int x_size, int z_size, unsigned int seed);
+
+	// whether a terrain is being generated or is waiting to be taken
+	bool busy() const { return this->running; }
+
+	// how far the terrain being generated has got, from 0 to 1
+	float progress() const { return this->generator.progress.load(std::memory_order_relaxed); }
+
+	// if a terrain has finished, swaps it into state and returns true.
+	// what state held before is kept as the buffer for the next terrain.
+	bool take(TerrainState &state);
+
+	// timings of the last terrain that was taken
+	TerrainTimings timings;
+
+private:
+	// the generator owns a thread, so it can't be copied
+	BackgroundGenerator(const BackgroundGenerator &other);
+	BackgroundGenerator &operator=(const BackgroundGenerator &other);
+
+	// generates into next, runs on the worker thread
+	static void run(BackgroundGenerator *self, int x_size, int z_size, unsigned int seed);
+
+	// only touched by the worker thread while it's running
+	TerrainGenerator generator;
+	TerrainState next;
+
+	std::thread thread;
+	// set by start(), cleared by take()
+	bool running;
+	// set by the worker thread once next is finished
+	std::atomic<bool> done;
+};
+
+#endif
@@ -0,0 +1,855 @@
+#include "terrainGenerator.h"
+#include "stampEngine.h"
+#include "normalKernel.h"
+#include "heightmapFile.h"
+#include "mathLib3D.h"
+#include "parallelFor.h"
+#include "riseAnimation.h"
+#include "terrainMesh.h"
+#include "PPM.h"
+#include "rayMarcher.h"
+#include "cameraPath.h"
+#include "heightQuery.h"
+#include "counterRng.h"
+#include "vecMath.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <map>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <chrono>
+
+// benchmarks for the terrain hot paths, run with 'make bench'.
+// usage: TerrainBench [--json <file>] [--baseline <file>] [--threshold <percent>]
+// every timing is also written to --json as {"name": ..., "ms": ...}, and compared
+// against the same names in --baseline (a file written by --json). anything slower
+// than the baseline by more than --threshold percent (10 by default) is reported
+// as a regression, and the exit status is 1 if there are any
+
+// returns milliseconds elapsed since start
+static double elapsedMs(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+* Runs work runs times and returns the fastest, in ms. The quick paths are
+* timed like this so one run disturbed by something else doesn't look like
+* a regression.
+*/
+template <typename Work>
+static double bestOf(int runs, Work work) {
+	double best = 0;
+	for (int run = 0; run < runs; run++) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		work();
+		double ms = elapsedMs(start);
+		if (run == 0 || ms < best) best = ms;
+	}
+	return best;
+}
+
+/**
+* One timing, for the JSON results and the baseline comparison.
+*/
+struct BenchResult {
+	std::string name;
+	double ms;
+};
+
+static std::vector<BenchResult> results;
+
+// records a timing under what/size, e.g. stamp/1024
+static void record(const std::string &what, int size, double ms) {
+	std::stringstream name;
+	name << what << "/" << size;
+	BenchResult result;
+	result.name = name.str();
+	result.ms = ms;
+	results.push_back(result);
+}
+
+// the original Point3D::distanceTo and Vec3D::normalize, before mathLib3D stopped using pow,
+// so the legacy passes are still the original code
+static float legacyDistance(Point3D a, Point3D b) {
+	return sqrt(pow(b.mX - a.mX, 2) + pow(b.mY - a.mY, 2) + pow(b.mZ - a.mZ, 2));
+}
+
+static float legacyLength(Vec3D v) {
+	return sqrt(pow(v.mX, 2) + pow(v.mY, 2) + pow(v.mZ, 2));
+}
+
+static Vec3D legacyNormalize(Vec3D v) {
+	return Vec3D(v.mX/legacyLength(v), v.mY/legacyLength(v), v.mZ/legacyLength(v));
+}
+
+// the original circle algorithm, visiting the whole grid for every circle
+static void legacyStamp(Grid<float> &heightmap, int x_size, int z_size, int tx, int tz, float disp, float &max_height) {
+	Point3D center = Point3D(tx, 0, tz);
+	float terrainCircleSize = (x_size + z_size) / 20;
+	for (int i = 0; i < x_size; i++) {
+		for (int j = 0; j < z_size; j++) {
+			float pd = (legacyDistance(center, Point3D(i, 0, j)) * 2) / terrainCircleSize;
+			if (fabs(pd) <= 1.0) {
+				heightmap(i, j) += disp/2 + (cos(pd*3.14)*disp)/2;
+				if (heightmap(i, j) > max_height) max_height = heightmap(i, j);
+			}
+		}
+	}
+}
+
+// fixes y-axis of a cross product, since all our vertex normals are pointing up.
+static Vec3D yfix(Vec3D in) {
+	if (in.mY < 0) return legacyNormalize(Vec3D(in.mX, -in.mY, in.mZ));
+	return legacyNormalize(in);
+}
+
+// the original normal pass, built from Vec3D cross products
+static void legacyNormals(TerrainState &state) {
+	for (int i = 0; i < state.x_size; i++) {
+		for (int j = 0; j < state.z_size; j++) {
+			Vec3D up = Vec3D();
+			Vec3D down = Vec3D();
+			Vec3D left = Vec3D();
+			Vec3D right = Vec3D();
+
+			// compute vectors along grid lines if present
+			if (i+1 < state.x_size) right = Vec3D(1, state.heightmap(i+1, j) - state.heightmap(i, j), 0);
+			if (i-1 >= 0) left = Vec3D(-1, state.heightmap(i-1, j) - state.heightmap(i, j), 0);
+			if (j+1 < state.z_size) up = Vec3D(0, state.heightmap(i, j+1) - state.heightmap(i, j), 1);
+			if (j-1 >= 0) down = Vec3D(0, state.heightmap(i, j-1) - state.heightmap(i, j), -1);
+
+			// compute cross products
+			Vec3D ur = yfix(up.cross(right));
+			Vec3D rd = yfix(right.cross(down));
+			Vec3D dl = yfix(down.cross(left));
+			Vec3D lu = yfix(left.cross(up));
+
+			// average of vectors
+			state.normals(i, j) = legacyNormalize(Vec3D((ur.mX + rd.mX + dl.mX + lu.mX) / 4, (ur.mY + rd.mY + dl.mY + lu.mY) / 4, (ur.mZ + rd.mZ + dl.mZ + lu.mZ) / 4));
+		}
+	}
+}
+
+/**
+* Stamps circles into a zeroed grid with either the legacy or bounded algorithm.
+* Only the first maxStamps circles are applied; returns the time taken in ms.
+*/
+static double runStamps(TerrainState &state, bool legacy, int maxStamps, unsigned int seed) {
+	int x_size = state.x_size;
+	int z_size = state.z_size;
+	StampEngine engine;
+	engine.setup((x_size + z_size) / 20);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	srand(seed);
+	float disp = (x_size+z_size) / 80;
+	for (int i = 0; i < (x_size+z_size)*2.5 && i < maxStamps; i++) {
+		int tx = 0 + (rand() % static_cast<int>(x_size + 1));
+		int tz = 0 + (rand() % static_cast<int>(z_size + 1));
+		if (legacy) legacyStamp(state.heightmap, x_size, z_size, tx, tz, disp, state.max_height);
+		else engine.apply(state.heightmap, tx, tz, disp, state.max_height);
+		disp /= 1.0005;
+	}
+	return elapsedMs(start);
+}
+
+/**
+* Checks the bounded engine produces exactly the heights of the legacy algorithm.
+*/
+static bool checkStampsMatch(int size) {
+	TerrainState legacy, bounded;
+	legacy.allocate(size, size);
+	bounded.allocate(size, size);
+	runStamps(legacy, true, 1 << 30, 1);
+	runStamps(bounded, false, 1 << 30, 1);
+
+	if (memcmp(legacy.heightmap.data(), bounded.heightmap.data(), legacy.heightmap.size() * sizeof(float)) != 0) return false;
+	return legacy.max_height == bounded.max_height;
+}
+
+/**
+* Times the full set of circles for a grid size with both algorithms.
+* The legacy algorithm is too slow to run to completion on large grids, so it
+* is timed over a sample of circles and extrapolated to the full count.
+*/
+static void benchStamps(int size) {
+	int stamps = (int)ceil((size + size) * 2.5);
+	int sample = stamps < 20 ? stamps : 20;
+	TerrainState state;
+
+	state.allocate(size, size);
+	double legacyMs = runStamps(state, true, sample, 1) * stamps / sample;
+
+	state.allocate(size, size);
+	double boundedMs = runStamps(state, false, stamps, 1);
+	record("stamp", size, boundedMs);
+
+	std::stringstream grid;
+	grid << size << "x" << size;
+	std::cout << std::setw(13) << grid.str()
+		<< std::setw(8) << stamps
+		<< std::setw(16) << legacyMs
+		<< std::setw(14) << boundedMs
+		<< std::setw(11) << (legacyMs / boundedMs) << "x" << std::endl;
+}
+
+// largest difference in any component between two sets of normals, ignoring the border
+// (the legacy pass produces NaN normals on the border, from normalizing zero vectors)
+static float maxInteriorError(const Grid<Vec3D> &a, const Grid<Vec3D> &b) {
+	float worst = 0;
+	for (int i = 1; i < a.x_size - 1; i++) {
+		for (int j = 1; j < a.z_size - 1; j++) {
+			float e = fabs(a(i, j).mX - b(i, j).mX);
+			if (fabs(a(i, j).mY - b(i, j).mY) > e) e = fabs(a(i, j).mY - b(i, j).mY);
+			if (fabs(a(i, j).mZ - b(i, j).mZ) > e) e = fabs(a(i, j).mZ - b(i, j).mZ);
+			if (!(e <= worst)) worst = e;
+		}
+	}
+	return worst;
+}
+
+/**
+* Times the legacy, scalar and SIMD normal passes over a generated terrain,
+* and checks the new kernels agree with the legacy pass.
+*/
+static void benchNormals(int size) {
+	TerrainState state;
+	TerrainGenerator generator;
+	generator.generate(state, size, size, 1);
+
+	Grid<Vec3D> simd, scalar;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	legacyNormals(state);
+	double legacyMs = elapsedMs(start);
+
+	double scalarMs = bestOf(3, [&]() { computeVertexNormalsScalar(state.heightmap, scalar); });
+	double simdMs = bestOf(3, [&]() { computeVertexNormals(state.heightmap, simd); });
+
+	record("normals", size, simdMs);
+	record("normals_scalar", size, scalarMs);
+
+	float error = maxInteriorError(state.normals, simd);
+	if (maxInteriorError(state.normals, scalar) > error) error = maxInteriorError(state.normals, scalar);
+
+	std::stringstream grid;
+	grid << size << "x" << size;
+	std::cout << std::setw(13) << grid.str()
+		<< std::setw(12) << legacyMs
+		<< std::setw(12) << scalarMs
+		<< std::setw(12) << simdMs
+		<< std::setw(11) << (legacyMs / simdMs) << "x"
+		<< std::setw(12) << std::scientific << std::setprecision(1) << error
+		<< (error < 1e-5 ? " ok" : " MISMATCH") << std::fixed << std::endl;
+}
+
+// a uniform float in [0, 1) for counter
+static float unitFloat(const CounterRng &rng, uint64_t counter) {
+	return (rng.bits(counter) >> 40) / 16777216.0f;
+}
+
+// prints a row of the vector math table, recording the batch time
+static void vecMathRow(const char *name, int count, double classMs, double batchMs, float error) {
+	record(name, count, batchMs);
+	std::cout << std::setw(13) << name
+		<< std::setw(12) << classMs
+		<< std::setw(12) << batchMs
+		<< std::setw(11) << (classMs / batchMs) << "x"
+		<< std::setw(12) << std::scientific << std::setprecision(1) << error
+		<< (error < 1e-5 ? " ok" : " MISMATCH") << std::fixed << std::endl;
+}
+
+/**
+* Times normalizing, crossing and measuring the distance between count
+* vectors with the Vec3D and Point3D classes, against the batch functions
+* of vecMath.h over the same vectors as structure of arrays, and checks
+* they agree.
+*/
+static void benchVecMath(int count) {
+	CounterRng rng(5);
+	std::vector<Vec3D> a(count), b(count), out(count);
+	std::vector<float> soa(count * 9), distances(count), classDistances(count);
+	Vec3Span as = {&soa[0], &soa[count], &soa[count * 2]};
+	Vec3Span bs = {&soa[count * 3], &soa[count * 4], &soa[count * 5]};
+	Vec3Span outs = {&soa[count * 6], &soa[count * 7], &soa[count * 8]};
+	for (int i = 0; i < count; i++) {
+		a[i] = Vec3D(unitFloat(rng, i * 6) - 0.5f, unitFloat(rng, i * 6 + 1) + 0.1f, unitFloat(rng, i * 6 + 2) - 0.5f);
+		b[i] = Vec3D(unitFloat(rng, i * 6 + 3) - 0.5f, unitFloat(rng, i * 6 + 4) - 0.5f, unitFloat(rng, i * 6 + 5) + 0.1f);
+		as.x[i] = a[i].mX; as.y[i] = a[i].mY; as.z[i] = a[i].mZ;
+		bs.x[i] = b[i].mX; bs.y[i] = b[i].mY; bs.z[i] = b[i].mZ;
+	}
+
+	// largest difference in any component between out and outs
+	auto error = [&]() {
+		float worst = 0;
+		for (int i = 0; i < count; i++) {
+			worst = std::max(worst, (float)fabs(out[i].mX - outs.x[i]));
+			worst = std::max(worst, (float)fabs(out[i].mY - outs.y[i]));
+			worst = std::max(worst, (float)fabs(out[i].mZ - outs.z[i]));
+		}
+		return worst;
+	};
+
+	double classMs = bestOf(3, [&]() { for (int i = 0; i < count; i++) out[i] = a[i].normalize(); });
+	double batchMs = bestOf(3, [&]() { normalizeN(as, outs, count); });
+	vecMathRow("normalize", count, classMs, batchMs, error());
+
+	classMs = bestOf(3, [&]() { for (int i = 0; i < count; i++) out[i] = a[i].cross(b[i]); });
+	batchMs = bestOf(3, [&]() { crossN(as, bs, outs, count); });
+	vecMathRow("cross", count, classMs, batchMs, error());
+
+	classMs = bestOf(3, [&]() {
+		for (int i = 0; i < count; i++) {
+			classDistances[i] = Point3D(a[i].mX, a[i].mY, a[i].mZ).distanceTo(Point3D(b[i].mX, b[i].mY, b[i].mZ));
+		}
+	});
+	batchMs = bestOf(3, [&]() { distanceN(as, bs, &distances[0], count); });
+	float worst = 0;
+	for (int i = 0; i < count; i++) worst = std::max(worst, (float)fabs(distances[i] - classDistances[i]));
+	vecMathRow("distance", count, classMs, batchMs, worst);
+}
+
+/**
+* Saves and loads a generated terrain (heights only), comparing the load time
+* against generating it again, and checks every height comes back to within
+* half a quantisation step.
+*/
+static void benchFiles(int size) {
+	TerrainState state, loaded;
+	TerrainGenerator generator;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	generator.generate(state, size, size, 1);
+	double generateMs = elapsedMs(start);
+
+	const char *file = "bench_terrain.thc";
+	const char *error = NULL;
+	bool ok = true;
+	double saveMs = bestOf(3, [&]() { ok = saveTerrain(state, file, false, &error) && ok; });
+	double loadMs = bestOf(3, [&]() { ok = ok && loadTerrain(loaded, file, &error); });
+
+	long bytes = 0;
+	FILE *in = fopen(file, "rb");
+	if (in) {
+		fseek(in, 0, SEEK_END);
+		bytes = ftell(in);
+		fclose(in);
+	}
+	remove(file);
+
+	float worst = 0;
+	for (size_t i = 0; ok && i < state.heightmap.size(); i++) {
+		float e = fabs(state.heightmap.data()[i] - loaded.heightmap.data()[i]);
+		if (!(e <= worst)) worst = e;
+	}
+	// half a step, plus a little for the rounding of floats that size
+	ok = ok && worst <= state.max_height * (0.5f / 65535 + 1e-6f);
+
+	record("generate", size, generateMs);
+	record("save", size, saveMs);
+	record("load", size, loadMs);
+
+	std::stringstream grid;
+	grid << size << "x" << size;
+	std::cout << std::setw(13) << grid.str()
+		<< std::setw(12) << generateMs
+		<< std::setw(12) << saveMs
+		<< std::setw(12) << loadMs
+		<< std::setw(12) << std::setprecision(2) << (bytes * 8.0 / state.heightmap.size()) << std::setprecision(1)
+		<< std::setw(14) << (generateMs / loadMs) << "x"
+		<< (ok ? " ok" : " MISMATCH") << std::endl;
+}
+
+/**
+* Times generating one terrain on 1 thread up to one per core, and checks each
+* thread count gives exactly the heights of the single threaded run.
+*/
+static void benchThreads(int size) {
+	TerrainState single, state;
+	TerrainGenerator generator;
+	generator.threads = 1;
+	generator.generate(single, size, size, 1);
+	double singleMs = generator.timings.stamp;
+
+	// powers of two, and then every core
+	std::vector<int> counts;
+	for (int threads = 1; threads < threadCount(0); threads *= 2) counts.push_back(threads);
+	counts.push_back(threadCount(0));
+
+	for (size_t i = 0; i < counts.size(); i++) {
+		int threads = counts[i];
+		generator.threads = threads;
+		generator.generate(state, size, size, 1);
+		bool same = memcmp(state.heightmap.data(), single.heightmap.data(), single.heightmap.size() * sizeof(float)) == 0
+			&& state.max_height == single.max_height;
+		std::stringstream what;
+		what << "stamp_threads" << threads;
+		record(what.str(), size, generator.timings.stamp);
+
+		std::stringstream grid;
+		grid << size << "x" << size;
+		std::cout << std::setw(13) << grid.str()
+			<< std::setw(9) << threads
+			<< std::setw(12) << generator.timings.stamp
+			<< std::setw(10) << (singleMs / generator.timings.stamp) << "x"
+			<< (same ? " identical" : " DIFFERENT") << std::endl;
+	}
+}
+
+/**
+* Renders a 640x480 preview of a terrain on the CPU from where the headless
+* orbit starts, on 1 thread up to one per core (the best of 3 each), and
+* checks every thread count draws the same image.
+*/
+static void benchRayMarch(int size) {
+	TerrainState state;
+	TerrainGenerator generator;
+	generator.generate(state, size, size, 1);
+	ColorRamp ramp;
+	SceneLight lights[SCENE_LIGHT_COUNT];
+	sceneLights(size, size, lights);
+	CameraPath path;
+	path.setOrbit(size, size, 1);
+	Viewpoint view = path.points[0];
+	Vec3D front = Vec3D(view.target.mX - view.eye.mX, view.target.mY - view.eye.mY, view.target.mZ - view.eye.mZ);
+	const int width = 640, height = 480;
+
+	RayMarcher marcher;
+	double buildMs = bestOf(3, [&]() { marcher.build(state); });
+	record("raymarch_build", size, buildMs);
+
+	std::vector<unsigned char> single(width * height * 3), pixels(width * height * 3);
+	std::vector<int> counts;
+	for (int threads = 1; threads < threadCount(0); threads *= 2) counts.push_back(threads);
+	counts.push_back(threadCount(0));
+
+	double singleMs = 0;
+	for (size_t i = 0; i < counts.size(); i++) {
+		marcher.threads = counts[i];
+		std::vector<unsigned char> &out = i == 0 ? single : pixels;
+		double ms = bestOf(3, [&]() {
+			marcher.render(state, view.eye, front, 90, 0.1, 1000, lights, ramp, width, height, &out[0]);
+		});
+		if (i == 0) singleMs = ms;
+		bool same = i == 0 || pixels == single;
+		std::stringstream what;
+		what << "raymarch_threads" << counts[i];
+		record(what.str(), size, ms);
+
+		std::stringstream grid;
+		grid << size << "x" << size;
+		std::cout << std::setw(13) << grid.str()
+			<< std::setw(9) << counts[i]
+			<< std::setw(12) << ms
+			<< std::setw(10) << (singleMs / ms) << "x"
+			<< std::setw(10) << ((double)marcher.cellsVisited / (width * height))
+			<< std::setw(10) << buildMs
+			<< (same ? " identical" : " DIFFERENT") << std::endl;
+	}
+}
+
+// casts count rays, from origins[i] along directions[i], returning how many hit
+static int castRays(const HeightQuery &query, const std::vector<Vec3D> &origins, const std::vector<Vec3D> &directions,
+		long &nodes) {
+	int hits = 0;
+	nodes = 0;
+	RayHit hit;
+	for (size_t i = 0; i < origins.size(); i++) {
+		if (query.intersect(origins[i], directions[i], 1e6, hit)) hits++;
+		nodes += query.nodesVisited;
+	}
+	return hits;
+}
+
+/**
+* Checks ray hits against walking each ray in steps of 1/64 of a cell and
+* finding where it first goes under height(), over 10000 random rays
+* starting above the ground.
+* Returns the largest difference in t (in cells) for rays both find, and
+* counts the rays where only one of them finds a hit.
+*/
+static double checkRayHits(int size, int &mismatches) {
+	TerrainState state;
+	TerrainGenerator generator;
+	generator.generate(state, size, size, 3);
+	HeightQuery query;
+	query.build(state.heightmap);
+	CounterRng rng(11);
+	double worst = 0;
+	mismatches = 0;
+	for (int i = 0; i < 10000; i++) {
+		float x = unitFloat(rng, i * 6) * (size - 1), z = unitFloat(rng, i * 6 + 2) * (size - 1);
+		Vec3D origin(x, query.height(x, z) + state.max_height * unitFloat(rng, i * 6 + 1), z);
+		Vec3D direction = Vec3D(unitFloat(rng, i * 6 + 3) - 0.5f, -unitFloat(rng, i * 6 + 4) * 0.5f, unitFloat(rng, i * 6 + 5) - 0.5f).normalize();
+		RayHit hit;
+		bool found = query.intersect(origin, direction, 1e6, hit);
+
+		double reference = -1;
+		const double step = 1.0 / 64;
+		for (double t = 0; ; t += step) {
+			double x = origin.mX + direction.mX * t, z = origin.mZ + direction.mZ * t;
+			if (!query.contains(x, z)) break;
+			if (origin.mY + direction.mY * t <= query.height(x, z)) {
+				reference = t;
+				break;
+			}
+		}
+		if (found != (reference >= 0)) {
+			// a ray that only just grazes a peak can go either way
+			mismatches++;
+		} else if (found) {
+			worst = std::max(worst, fabs(hit.t - reference));
+		}
+	}
+	return worst;
+}
+
+/**
+* Times building the quadtree, a million height samples one at a time and
+* as a batch, and rays cast down from above the terrain and skimming along
+* near the ground (which pass over far more of it before they hit).
+*/
+static void benchQueries(int size) {
+	TerrainState state;
+	TerrainGenerator generator;
+	generator.generate(state, size, size, 1);
+	HeightQuery query;
+	double buildMs = bestOf(3, [&]() { query.build(state.heightmap); });
+	record("query_build", size, buildMs);
+
+	const int samples = 1000000;
+	CounterRng rng(7);
+	std::vector<float> xs(samples), zs(samples), out(samples);
+	for (int i = 0; i < samples; i++) {
+		xs[i] = unitFloat(rng, i * 2) * (size - 1);
+		zs[i] = unitFloat(rng, i * 2 + 1) * (size - 1);
+	}
+	double sampleMs = bestOf(3, [&]() {
+		for (int i = 0; i < samples; i++) out[i] = query.height(xs[i], zs[i]);
+	});
+	double batchMs = bestOf(3, [&]() { query.heights(&xs[0], &zs[0], samples, &out[0]); });
+	record("query_sample", size, sampleMs);
+	record("query_batch", size, batchMs);
+
+	const int rays = 200000;
+	std::vector<Vec3D> steepOrigins(rays), steepDirections(rays), skimOrigins(rays), skimDirections(rays);
+	for (int i = 0; i < rays; i++) {
+		float x = unitFloat(rng, samples * 2 + i * 4) * (size - 1);
+		float z = unitFloat(rng, samples * 2 + i * 4 + 1) * (size - 1);
+		float angle = unitFloat(rng, samples * 2 + i * 4 + 2) * 2 * M_PI;
+		steepOrigins[i] = Vec3D(x, state.max_height * 2, z);
+		steepDirections[i] = Vec3D(cos(angle) * 0.3f, -1, sin(angle) * 0.3f);
+		// from just above the ground, nearly level, like looking at the horizon
+		skimOrigins[i] = Vec3D(x, query.height(x, z) + 1.5f, z);
+		skimDirections[i] = Vec3D(cos(angle), -0.02f, sin(angle));
+	}
+	long steepNodes = 0, skimNodes = 0;
+	int steepHits = 0, skimHits = 0;
+	double steepMs = bestOf(3, [&]() { steepHits = castRays(query, steepOrigins, steepDirections, steepNodes); });
+	double skimMs = bestOf(3, [&]() { skimHits = castRays(query, skimOrigins, skimDirections, skimNodes); });
+	record("query_rays_steep", size, steepMs);
+	record("query_rays_skim", size, skimMs);
+
+	std::stringstream grid;
+	grid << size << "x" << size;
+	std::cout << std::setw(13) << grid.str()
+		<< std::setw(8) << buildMs
+		<< std::setw(10) << (samples / sampleMs / 1000)
+		<< std::setw(10) << (samples / batchMs / 1000)
+		<< std::setw(10) << (rays / steepMs / 1000)
+		<< std::setw(8) << ((double)steepNodes / rays)
+		<< std::setw(7) << (100.0 * steepHits / rays) << "%"
+		<< std::setw(10) << (rays / skimMs / 1000)
+		<< std::setw(8) << ((double)skimNodes / rays)
+		<< std::setw(7) << (100.0 * skimHits / rays) << "%" << std::endl;
+}
+
+/**
+* Times decoding each of the bundled texture images, the best of 3 runs.
+*/
+static void benchImages() {
+	const char *files[] = {"marble.ppm", "aerial.ppm", "teapot.ppm", "baboon.ppm"};
+	for (int i = 0; i < 4; i++) {
+		int width = 0, height = 0;
+		const char *error = NULL;
+		double best = bestOf(3, [&]() { free(LoadPPM(files[i], &width, &height, &error)); });
+		if (error) {
+			std::cout << std::setw(13) << files[i] << "  could not load: " << error << std::endl;
+			continue;
+		}
+
+		std::stringstream size;
+		size << width << "x" << height;
+		std::cout << std::setw(13) << files[i]
+			<< std::setw(12) << size.str()
+			<< std::setw(12) << best
+			<< std::setw(12) << (width * height * 3 / best / 1000) << std::endl;
+
+		BenchResult result;
+		result.name = std::string("load_ppm/") + files[i];
+		result.ms = best;
+		results.push_back(result);
+	}
+}
+
+/**
+* Plays the whole rise animation at 60 frames a second, as the viewer does,
+* timing the advance and the hand-over of the regions to upload each frame.
+*/
+static void benchRise(int size) {
+	TerrainState state;
+	TerrainGenerator generator;
+	generator.generate(state, size, size, 1);
+
+	RiseAnimation rise;
+	std::vector<TerrainRegion> regions;
+	TerrainRegion bounds;
+	const double duration = 4.0;
+	int frames = 0;
+	double worst = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	rise.start(state, duration);
+	while (!rise.settled()) {
+		std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+		rise.advance(state, ++frames / 60.0);
+		rise.takeDirty(regions, bounds);
+		worst = std::max(worst, elapsedMs(frameStart));
+	}
+	double totalMs = elapsedMs(start);
+	record("rise", size, totalMs);
+
+	std::stringstream grid;
+	grid << size << "x" << size;
+	std::cout << std::setw(13) << grid.str()
+		<< std::setw(8) << frames
+		<< std::setw(12) << totalMs
+		<< std::setw(12) << (totalMs / frames)
+		<< std::setw(12) << worst << std::endl;
+}
+
+/**
+* Builds the vertices of every chunk at full detail and at the coarsest
+* level, the CPU side of what the renderer uploads. The best of 3 runs.
+*/
+static void benchVertices(int size) {
+	TerrainState state;
+	TerrainGenerator generator;
+	generator.generate(state, size, size, 1);
+	ColorRamp ramp;
+	std::vector<TerrainVertex> vertices;
+
+	double ms[2];
+	long count[2];
+	int levels[2] = {0, CHUNK_LEVELS - 1};
+	int chunks = chunkCount(size - 1);
+	for (int l = 0; l < 2; l++) {
+		ms[l] = bestOf(3, [&]() {
+			count[l] = 0;
+			for (int cx = 0; cx < chunks; cx++) {
+				for (int cz = 0; cz < chunks; cz++) {
+					int x0 = chunkStart(cx);
+					int z0 = chunkStart(cz);
+					int nx = chunkCells(cx, size - 1);
+					int nz = chunkCells(cz, size - 1);
+					int level = std::min(levels[l], chunkMaxLevel(nx, nz));
+					int n = levelVertexCount(nx, level) * levelVertexCount(nz, level);
+					vertices.resize(n);
+					assembleChunkVertices(&state.heightmap(x0, z0), &state.normals(x0, z0), size, state.max_height, ramp,
+						x0, z0, nx, nz, level, &vertices[0]);
+					count[l] += n;
+				}
+			}
+		});
+	}
+	record("vertices", size, ms[0]);
+	record("vertices_coarsest", size, ms[1]);
+
+	std::stringstream grid;
+	grid << size << "x" << size;
+	std::cout << std::setw(13) << grid.str()
+		<< std::setw(12) << ms[0]
+		<< std::setw(12) << (count[0] / ms[0] / 1000)
+		<< std::setw(12) << ms[1]
+		<< std::setw(12) << (count[1] / ms[1] / 1000) << std::endl;
+}
+
+/**
+* Writes every result as JSON, one per line.
+*/
+static bool writeResults(const char *file) {
+	std::ofstream out(file);
+	if (!out) return false;
+	out << std::fixed << std::setprecision(3);
+	out << "{\n";
+	out << "  \"threads\": " << threadCount(0) << ",\n";
+	out << "  \"normal_kernel\": \"" << normalKernelName() << "\",\n";
+	out << "  \"results\": [\n";
+	for (size_t i = 0; i < results.size(); i++) {
+		out << "    {\"name\": \"" << results[i].name << "\", \"ms\": " << results[i].ms << "}"
+			<< (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	out << "  ]\n}\n";
+	return out.good();
+}
+
+/**
+* Reads the name and ms of every result in a file written by writeResults.
+* It only has to understand that layout, so it just looks for the two keys.
+*/
+static bool readResults(const char *file, std::map<std::string, double> &baseline) {
+	std::ifstream in(file);
+	if (!in) return false;
+	std::string line;
+	while (std::getline(in, line)) {
+		size_t name = line.find("\"name\": \"");
+		size_t ms = line.find("\"ms\": ");
+		if (name == std::string::npos || ms == std::string::npos) continue;
+		name += 9;
+		size_t end = line.find('"', name);
+		if (end == std::string::npos) continue;
+		baseline[line.substr(name, end - name)] = atof(line.c_str() + ms + 6);
+	}
+	return true;
+}
+
+/**
+* Compares the results against a baseline, returning the number of regressions.
+* Differences under half a millisecond are timer noise, not regressions.
+*/
+static int compareResults(const std::map<std::string, double> &baseline, double threshold) {
+	int regressions = 0;
+	std::cout << "                        name    baseline         now    change" << std::endl;
+	for (size_t i = 0; i < results.size(); i++) {
+		std::map<std::string, double>::const_iterator it = baseline.find(results[i].name);
+		if (it == baseline.end()) continue;
+		double change = it->second > 0 ? (results[i].ms / it->second - 1) * 100 : 0;
+		bool regressed = change > threshold && results[i].ms - it->second > 0.5;
+		if (regressed) regressions++;
+		std::cout << std::setw(28) << results[i].name
+			<< std::setw(12) << it->second
+			<< std::setw(12) << results[i].ms
+			<< std::setw(9) << std::showpos << change << std::noshowpos << "%"
+			<< (regressed ? " REGRESSION" : "") << std::endl;
+	}
+	return regressions;
+}
+
+int main(int argc, char** argv)
+{
+	const char *jsonFile = NULL;
+	const char *baselineFile = NULL;
+	double threshold = 10;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) jsonFile = argv[++i];
+		else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) baselineFile = argv[++i];
+		else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) threshold = atof(argv[++i]);
+		else {
+			std::cout << "usage: " << argv[0] << " [--json <file>] [--baseline <file>] [--threshold <percent>]" << std::endl;
+			return -1;
+		}
+	}
+
+	std::cout << std::fixed << std::setprecision(1);
+
+	std::cout << "stamping: bounded engine matches legacy at 200x200: "
+		<< (checkStampsMatch(200) ? "yes" : "NO") << std::endl;
+	std::cout << "stamping (ms, legacy extrapolated from 20 circles)" << std::endl;
+	std::cout << "         grid  stamps          legacy       bounded    speedup" << std::endl;
+	int sizes[] = {250, 500, 1000, 2000, 4000};
+	for (int i = 0; i < 5; i++) {
+		benchStamps(sizes[i]);
+	}
+
+	std::cout << "stamping threads (ms, " << TerrainGenerator::BAND_ROWS << "-row bands, "
+		<< threadCount(0) << " cores)" << std::endl;
+	std::cout << "         grid  threads       stamp   speedup" << std::endl;
+	int threadSizes[] = {1024, 4096};
+	for (int i = 0; i < 2; i++) {
+		benchThreads(threadSizes[i]);
+	}
+
+	std::cout << "ray marched previews (ms, 640x480, best of 3, " << RayMarcher::TILE_SIZE << "px tiles, "
+		<< threadCount(0) << " cores)" << std::endl;
+	std::cout << "         grid  threads      render   speedup cells/ray     build" << std::endl;
+	int marchSizes[] = {512, 2048};
+	for (int i = 0; i < 2; i++) {
+		benchRayMarch(marchSizes[i]);
+	}
+
+	int mismatches = 0;
+	double rayError = checkRayHits(257, mismatches);
+	std::cout << "height queries: ray hits within " << std::setprecision(4) << rayError << std::setprecision(1)
+		<< " cells of a 1/64 cell march at 257x257, " << mismatches << " of 10000 rays disagree" << std::endl;
+	std::cout << "height queries (build ms, then millions a second; nodes visited and hits per ray)" << std::endl;
+	std::cout << "         grid   build    sample     batch     steep   nodes   hits      skim   nodes   hits" << std::endl;
+	int querySizes[] = {1024, 4096};
+	for (int i = 0; i < 2; i++) {
+		benchQueries(querySizes[i]);
+	}
+
+	std::cout << "normals (ms, " << normalKernelName() << " kernel, error is max component difference from legacy)" << std::endl;
+	std::cout << "         grid      legacy      scalar        simd    speedup       error" << std::endl;
+	int normalSizes[] = {512, 1024, 2048};
+	for (int i = 0; i < 3; i++) {
+		benchNormals(normalSizes[i]);
+	}
+
+	std::cout << "vector math (ms for 1M vectors, " << vecMathName() << " batches against Vec3D/Point3D)" << std::endl;
+	std::cout << "           op       class       batch    speedup       error" << std::endl;
+	benchVecMath(1000000);
+
+	std::cout << "terrain files (ms, 16-bit heights, " << HEIGHTMAP_STRIPE_ROWS << "-row stripes over "
+		<< threadCount(0) << " threads)" << std::endl;
+	std::cout << "         grid    generate        save        load   bits/cell  load vs generate" << std::endl;
+	int fileSizes[] = {1024, 2048, 4096};
+	for (int i = 0; i < 3; i++) {
+		benchFiles(fileSizes[i]);
+	}
+
+	std::cout << "texture images (ms, best of 3)" << std::endl;
+	std::cout << "         file        size        load   MB/s" << std::endl;
+	benchImages();
+
+	std::cout << "rise animation (ms, 60 frames a second)" << std::endl;
+	std::cout << "         grid  frames       total   per frame  worst frame" << std::endl;
+	int riseSizes[] = {512, 1024, 2048};
+	for (int i = 0; i < 3; i++) {
+		benchRise(riseSizes[i]);
+	}
+
+	std::cout << "chunk vertices (ms, best of 3, every chunk)" << std::endl;
+	std::cout << "         grid     level 0  Mverts/s     level " << (CHUNK_LEVELS - 1) << "  Mverts/s" << std::endl;
+	int vertexSizes[] = {1024, 2048};
+	for (int i = 0; i < 2; i++) {
+		benchVertices(vertexSizes[i]);
+	}
+
+	if (jsonFile) {
+		if (!writeResults(jsonFile)) {
+			std::cout << "could not write " << jsonFile << std::endl;
+			return -1;
+		}
+		std::cout << "wrote " << results.size() << " results to " << jsonFile << std::endl;
+	}
+
+	if (baselineFile) {
+		std::map<std::string, double> baseline;
+		if (!readResults(baselineFile, baseline)) {
+			std::cout << "could not read " << baselineFile << std::endl;
+			return -1;
+		}
+		std::cout << "against " << baselineFile << " (regression threshold " << threshold << "%)" << std::endl;
+		int regressions = compareResults(baseline, threshold);
+		if (regressions > 0) {
+			std::cout << regressions << " regression" << (regressions == 1 ? "" : "s") << std::endl;
+			return 1;
+		}
+		std::cout << "no regressions" << std::endl;
+	}
+
+	return 0;
+}
@@ -10,6 +10,7 @@
 
 #include "camera.h"
 #include "mathLib3D.h"
+#include "vecMath.h"
 
 // a significant amount of 3d camera code was converted from code in
 // https://learnopengl.com/Getting-started/Camera
@@ -42,6 +43,12 @@ Camera::Camera(Vec3D camPos, Vec3D camTgt) {
 
 	// sensitivity default value
 	this->sens = 0.1;
+
+	// 90 fov, square aspect
+	this->fov = 90;
+	this->aspect = 1.0;
+	this->nearPlane = 0.1;
+	this->farPlane = 1000;
 }
 
 /**
@@ -52,8 +59,8 @@ void Camera::setupPerspective() {
 	glMatrixMode(GL_PROJECTION);
 	glLoadIdentity();
 
-	// set up perspective with 90 fov
-	gluPerspective(90, 1.0, 0.1, 1000);
+	// set up perspective (90 fov by default)
+	gluPerspective(this->fov, this->aspect, this->nearPlane, this->farPlane);
 }
 
 /**
@@ -93,9 +100,11 @@ void Camera::applyRotation() {
 	if (pitch < -89.0) pitch = -89.0;
 
 	// compute the new camFront based on the pitch/yaw angles.
-	float mX = cos((3.14*this->pitch)/180) * cos((3.14*this->yaw)/180);
-	float mY = sin((3.14*this->pitch)/180);
-	float mZ = cos((3.14*this->pitch)/180) * sin((3.14*this->yaw)/180);
+	float pitchRadians = degreesToRadians(this->pitch);
+	float yawRadians = degreesToRadians(this->yaw);
+	float mX = cosf(pitchRadians) * cosf(yawRadians);
+	float mY = sinf(pitchRadians);
+	float mZ = cosf(pitchRadians) * sinf(yawRadians);
 
 	this->camFront = Vec3D(mX, mY, mZ).normalize();
 }
@@ -45,6 +45,12 @@ public:
 	// sensitivity of camera rotations
 	float sens;
 
+	// the perspective projection: vertical field of view (degrees), aspect ratio and clip planes
+	float fov;
+	float aspect;
+	float nearPlane;
+	float farPlane;
+
 	// Sets up perspective view
 	void setupPerspective();
 
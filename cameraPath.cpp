@@ -0,0 +1,72 @@
+#include "cameraPath.h"
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cmath>
+#include <algorithm>
+
+bool CameraPath::load(const char *file, const char **error) {
+	std::ifstream in(file);
+	if (!in) {
+		if (error) *error = "could not open file";
+		return false;
+	}
+
+	std::vector<Viewpoint> loaded;
+	std::string line;
+	while (std::getline(in, line)) {
+		line = line.substr(0, line.find('#'));
+		if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+		std::istringstream fields(line);
+		Viewpoint point;
+		if (!(fields >> point.eye.mX >> point.eye.mY >> point.eye.mZ
+				>> point.target.mX >> point.target.mY >> point.target.mZ)) {
+			if (error) *error = "expected \"eye_x eye_y eye_z target_x target_y target_z\" on each line";
+			return false;
+		}
+		loaded.push_back(point);
+	}
+	if (loaded.empty()) {
+		if (error) *error = "no viewpoints";
+		return false;
+	}
+
+	this->points.swap(loaded);
+	return true;
+}
+
+/**
+* The last viewpoint isn't back at the first, so the orbit can be looped
+* without drawing the same frame twice.
+*/
+void CameraPath::setOrbit(float center_x, float center_z, float radius, float height, float target_y, int count) {
+	this->points.resize(count);
+	for (int i = 0; i < count; i++) {
+		double angle = 2 * M_PI * i / count;
+		this->points[i].eye = Vec3D(center_x + radius * cos(angle), height, center_z + radius * sin(angle));
+		this->points[i].target = Vec3D(center_x, target_y, center_z);
+	}
+}
+
+void CameraPath::setOrbit(int x_size, int z_size, int count) {
+	float radius = std::max(x_size, z_size) * 0.75f;
+	this->setOrbit(x_size / 2.0f, z_size / 2.0f, radius, radius / 2, 0, count);
+}
+
+// a + (b - a) * t
+static Vec3D lerp(const Vec3D &a, const Vec3D &b, float t) {
+	return Vec3D(a.mX + (b.mX - a.mX) * t, a.mY + (b.mY - a.mY) * t, a.mZ + (b.mZ - a.mZ) * t);
+}
+
+Viewpoint CameraPath::at(float t) const {
+	if (this->points.size() < 2 || t <= 0) return this->points.front();
+	if (t >= 1) return this->points.back();
+	float position = t * (this->points.size() - 1);
+	size_t i = (size_t)position;
+	float fraction = position - i;
+	Viewpoint point;
+	point.eye = lerp(this->points[i].eye, this->points[i + 1].eye, fraction);
+	point.target = lerp(this->points[i].target, this->points[i + 1].target, fraction);
+	return point;
+}
@@ -0,0 +1,38 @@
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+#include "mathLib3D.h"
+#include <vector>
+
+/**
+* Where the camera is and the point it's looking at.
+*/
+struct Viewpoint {
+	Vec3D eye;
+	Vec3D target;
+};
+
+/**
+* A list of viewpoints for the camera to go through, for rendering
+* without a window. Frames in between viewpoints are interpolated linearly.
+*/
+class CameraPath {
+public:
+	// reads viewpoints from a text file, one "eye_x eye_y eye_z target_x target_y target_z"
+	// per line ('#' starts a comment). returns false and leaves the path alone if the file is bad.
+	bool load(const char *file, const char **error = 0);
+
+	// replaces the path with count viewpoints evenly spaced on a circle of radius
+	// around (center_x, center_z) at height, all looking at the center at target_y
+	void setOrbit(float center_x, float center_z, float radius, float height, float target_y, int count);
+
+	// an orbit of count viewpoints framing a terrain of the given size from above its edges
+	void setOrbit(int x_size, int z_size, int count);
+
+	// the point t of the way along the path, from 0 at the first viewpoint to 1 at the last
+	Viewpoint at(float t) const;
+
+	std::vector<Viewpoint> points;
+};
+
+#endif
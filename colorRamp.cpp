@@ -0,0 +1,98 @@
+#include "colorRamp.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+ColorRamp::ColorRamp() {
+	this->setTopographic();
+}
+
+void ColorRamp::setTopographic() {
+	this->clear();
+	this->addStop(0.0, 0, 255, 0);
+	this->addStop(0.5, 255, 0, 0);
+	this->build();
+}
+
+void ColorRamp::clear() {
+	this->stops.clear();
+}
+
+void ColorRamp::addStop(float position, int r, int g, int b) {
+	Stop stop;
+	stop.position = position;
+	stop.rgb[0] = (unsigned char)std::min(std::max(r, 0), 255);
+	stop.rgb[1] = (unsigned char)std::min(std::max(g, 0), 255);
+	stop.rgb[2] = (unsigned char)std::min(std::max(b, 0), 255);
+	this->stops.push_back(stop);
+}
+
+/**
+* Interpolates the stops into the table. Heights below the first stop get
+* its color and heights above the last one get the last color.
+*/
+void ColorRamp::build() {
+	std::stable_sort(this->stops.begin(), this->stops.end(), [](const Stop &a, const Stop &b) {
+		return a.position < b.position;
+	});
+
+	size_t next = 0;
+	for (int i = 0; i < TABLE_SIZE; i++) {
+		unsigned char *rgba = &this->table[i * 4];
+		rgba[3] = 255;
+		if (this->stops.empty()) {
+			rgba[0] = rgba[1] = rgba[2] = 255;
+			continue;
+		}
+
+		float t = (float)i / (TABLE_SIZE - 1);
+		while (next < this->stops.size() && this->stops[next].position <= t) next++;
+
+		if (next == 0 || next == this->stops.size()) {
+			// before the first or after the last stop
+			const Stop &stop = this->stops[next == 0 ? 0 : next - 1];
+			for (int c = 0; c < 3; c++) rgba[c] = stop.rgb[c];
+		} else {
+			const Stop &a = this->stops[next - 1];
+			const Stop &b = this->stops[next];
+			float f = (t - a.position) / (b.position - a.position);
+			for (int c = 0; c < 3; c++) {
+				rgba[c] = (unsigned char)(a.rgb[c] + (b.rgb[c] - a.rgb[c]) * f + 0.5f);
+			}
+		}
+	}
+}
+
+bool ColorRamp::load(const char *file, const char **error) {
+	std::ifstream in(file);
+	if (!in) {
+		if (error) *error = "could not open file";
+		return false;
+	}
+
+	ColorRamp loaded;
+	loaded.clear();
+	std::string line;
+	while (std::getline(in, line)) {
+		line = line.substr(0, line.find('#'));
+		if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+		std::istringstream fields(line);
+		float position;
+		int r, g, b;
+		if (!(fields >> position >> r >> g >> b)) {
+			if (error) *error = "expected \"position r g b\" on each line";
+			return false;
+		}
+		loaded.addStop(position, r, g, b);
+	}
+	if (loaded.stops.empty()) {
+		if (error) *error = "no color stops";
+		return false;
+	}
+
+	loaded.build();
+	*this = loaded;
+	return true;
+}
@@ -0,0 +1,54 @@
+#ifndef COLOR_RAMP_H
+#define COLOR_RAMP_H
+
+#include <vector>
+
+/**
+* Maps a height (as a fraction of the max height) to a color.
+* The ramp is a list of stops that are linearly interpolated between, baked
+* into a lookup table so coloring a vertex is one multiply and one load.
+*/
+class ColorRamp {
+public:
+	// number of entries in the lookup table
+	static const int TABLE_SIZE = 1024;
+
+	// starts out as the default topographic ramp
+	ColorRamp();
+
+	// the default ramp, green at the bottom fading to red at half the max height
+	void setTopographic();
+
+	// removes all of the stops (the table isn't rebuilt until build() is called)
+	void clear();
+
+	// adds a stop at position (0 is the ground, 1 is the max height) with a color in 0-255
+	void addStop(float position, int r, int g, int b);
+
+	// rebuilds the lookup table from the stops
+	void build();
+
+	// reads stops from a text file, one "position r g b" per line ('#' starts a comment),
+	// and rebuilds the table. returns false and leaves the ramp alone if the file is bad.
+	bool load(const char *file, const char **error = 0);
+
+	// the RGBA color of height y on a terrain whose highest point is max_height
+	inline const unsigned char *lookup(float y, float max_height) const {
+		float t = y / max_height * (TABLE_SIZE - 1) + 0.5f;
+		// written so NaN ends up at the bottom too
+		int i = t > 0 ? (int)t : 0;
+		if (i > TABLE_SIZE - 1) i = TABLE_SIZE - 1;
+		return &this->table[i * 4];
+	}
+
+private:
+	struct Stop {
+		float position;
+		unsigned char rgb[3];
+	};
+
+	std::vector<Stop> stops;
+	unsigned char table[TABLE_SIZE * 4];
+};
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef COUNTER_RNG_H
+#define COUNTER_RNG_H
+
+#include <stdint.h>
+
+/**
+* A counter-based random number generator: the n-th number of a stream is a
+* hash of the seed and n, not the next step of a shared state. Any number can
+* be had without generating the ones before it, from any thread, and a seed
+* gives the same numbers on every platform (unlike rand()).
+*
+* The hash is the SplitMix64 finalizer, applied to the counter offset by a
+* key mixed from the seed.
+*/
+class CounterRng {
+public:
+	CounterRng(uint64_t seed) {
+		this->key = mix(seed + 0x9e3779b97f4a7c15ULL);
+	}
+
+	// 64 random bits for counter
+	uint64_t bits(uint64_t counter) const {
+		return mix(this->key + counter * 0x9e3779b97f4a7c15ULL);
+	}
+
+	// a uniform integer in [0, n) for counter
+	uint32_t below(uint64_t counter, uint32_t n) const {
+		// the top 32 bits scaled to the range, which is biased by less than n / 2^32
+		return (uint32_t)(((this->bits(counter) >> 32) * n) >> 32);
+	}
+
+private:
+	static uint64_t mix(uint64_t z) {
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		return z ^ (z >> 31);
+	}
+
+	uint64_t key;
+};
+
+#endif
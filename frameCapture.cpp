@@ -0,0 +1,171 @@
+#include "frameCapture.h"
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+
+// returns milliseconds elapsed since start
+static double elapsedMs(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+FrameCapture::FrameCapture() {
+	this->waitMs = 0;
+	this->writeMs.store(0);
+	this->written.store(0);
+	this->failed.store(0);
+	this->width = 0;
+	this->height = 0;
+	this->buffers[0] = this->buffers[1] = 0;
+	this->pending[0] = this->pending[1] = -1;
+	this->next = 0;
+	this->stopping = false;
+}
+
+/**
+* Frames still waiting are dropped. The buffers go with the context, the
+* same as the profiler's queries.
+*/
+FrameCapture::~FrameCapture() {
+	if (this->thread.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+			this->stopping = true;
+			this->queue.clear();
+		}
+		this->changed.notify_all();
+		this->thread.join();
+	}
+}
+
+void FrameCapture::start(int width, int height, const std::string &prefix) {
+	this->width = width;
+	this->height = height;
+	this->prefix = prefix;
+	glGenBuffers(2, this->buffers);
+	for (int i = 0; i < 2; i++) {
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, this->buffers[i]);
+		glBufferData(GL_PIXEL_PACK_BUFFER, (size_t)width * height * 4, NULL, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	this->stopping = false;
+	this->thread = std::thread(run, this);
+}
+
+/**
+* RGBA rather than RGB, it's the framebuffer's own layout and lets drivers
+* copy it without converting.
+*/
+void FrameCapture::capture(int frame) {
+	int slot = this->next;
+	this->next = 1 - slot;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, this->buffers[slot]);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, this->width, this->height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	this->pending[slot] = frame;
+
+	if (this->pending[this->next] >= 0) this->collect(this->next);
+}
+
+void FrameCapture::collect(int slot) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	Frame frame;
+	frame.number = this->pending[slot];
+	this->pending[slot] = -1;
+	{
+		// wait for room in the queue, and take some storage back from the writer while there
+		std::unique_lock<std::mutex> lock(this->mutex);
+		while (this->queue.size() >= (size_t)QUEUE_LIMIT) this->changed.wait(lock);
+		if (!this->spare.empty()) {
+			frame.pixels.swap(this->spare.back());
+			this->spare.pop_back();
+		}
+	}
+	frame.pixels.resize((size_t)this->width * this->height * 4);
+
+	// this is where the loop waits if the copy hasn't finished
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, this->buffers[slot]);
+	const void *pixels = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+	if (pixels) {
+		memcpy(&frame.pixels[0], pixels, frame.pixels.size());
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	this->waitMs += elapsedMs(start);
+	if (!pixels) {
+		this->failed++;
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->queue.push_back(Frame());
+		this->queue.back().number = frame.number;
+		this->queue.back().pixels.swap(frame.pixels);
+	}
+	this->changed.notify_all();
+}
+
+void FrameCapture::finish() {
+	// the last frame read is the only one still in a buffer
+	int last = 1 - this->next;
+	if (this->pending[last] >= 0) this->collect(last);
+	if (!this->thread.joinable()) return;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->stopping = true;
+	}
+	this->changed.notify_all();
+	this->thread.join();
+}
+
+/**
+* Runs on the writer thread.
+*/
+void FrameCapture::run(FrameCapture *self) {
+	std::unique_lock<std::mutex> lock(self->mutex);
+	while (true) {
+		while (self->queue.empty() && !self->stopping) self->changed.wait(lock);
+		if (self->queue.empty()) return;
+		Frame frame;
+		frame.number = self->queue.front().number;
+		frame.pixels.swap(self->queue.front().pixels);
+		self->queue.pop_front();
+		// there's room in the queue now
+		self->changed.notify_all();
+
+		lock.unlock();
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		if (self->write(frame)) self->written++;
+		else self->failed++;
+		self->writeMs.store(self->writeMs.load() + elapsedMs(start));
+		lock.lock();
+		self->spare.push_back(std::vector<unsigned char>());
+		self->spare.back().swap(frame.pixels);
+	}
+}
+
+/**
+* GL's rows start at the bottom and PPM's at the top, so rows are written in
+* reverse, dropping the alpha.
+*/
+bool FrameCapture::write(const Frame &frame) {
+	char name[16];
+	snprintf(name, sizeof(name), "%04d.ppm", frame.number);
+	FILE *file = fopen((this->prefix + name).c_str(), "wb");
+	if (!file) return false;
+	fprintf(file, "P6\n%d %d\n255\n", this->width, this->height);
+	std::vector<unsigned char> row(this->width * 3);
+	bool ok = true;
+	for (int y = this->height - 1; y >= 0 && ok; y--) {
+		const unsigned char *in = &frame.pixels[(size_t)y * this->width * 4];
+		for (int x = 0; x < this->width; x++) {
+			row[x * 3] = in[x * 4];
+			row[x * 3 + 1] = in[x * 4 + 1];
+			row[x * 3 + 2] = in[x * 4 + 2];
+		}
+		ok = fwrite(&row[0], 1, row.size(), file) == row.size();
+	}
+	return fclose(file) == 0 && ok;
+}
@@ -0,0 +1,89 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include "glExtensions.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+/**
+* Reads rendered frames back from the framebuffer and writes them out as PPM
+* images, without holding up the frames that follow.
+*
+* Each frame is read into one of two pixel buffer objects, so glReadPixels
+* returns straight away and the copy happens while the next frame is drawn.
+* A buffer is only mapped a frame later, when its copy has had time to
+* finish, and the pixels are handed to a writer thread that flips and
+* encodes them. Up to QUEUE_LIMIT frames can wait to be written before
+* capturing another one waits for the writer.
+*/
+class FrameCapture {
+public:
+	// frames waiting for the writer thread before capture() blocks
+	static const int QUEUE_LIMIT = 8;
+
+	FrameCapture();
+	~FrameCapture();
+
+	// sets up for width x height frames, written to <prefix><frame>.ppm
+	// (the frame number padded to 4 digits), and starts the writer thread
+	void start(int width, int height, const std::string &prefix);
+
+	// starts reading back the frame that was just drawn, numbered frame, and
+	// hands the one before it (which has had a frame to arrive) to the writer
+	void capture(int frame);
+
+	// hands over the last frame and waits for every frame to be written
+	void finish();
+
+	// ms the render loop spent waiting, on a read back or for room in the queue
+	double waitMs;
+	// ms the writer thread spent writing files
+	std::atomic<double> writeMs;
+	// frames written, and frames that couldn't be
+	std::atomic<int> written;
+	std::atomic<int> failed;
+
+private:
+	// the capture owns GL buffers and a thread, so it can't be copied
+	FrameCapture(const FrameCapture &other);
+	FrameCapture &operator=(const FrameCapture &other);
+
+	struct Frame {
+		int number;
+		// RGBA, bottom row first as GL reads it
+		std::vector<unsigned char> pixels;
+	};
+
+	// maps a pixel buffer that's been read into and queues its frame
+	void collect(int slot);
+
+	// writes queued frames until finish() is called, runs on the writer thread
+	static void run(FrameCapture *self);
+
+	// writes a single frame
+	bool write(const Frame &frame);
+
+	int width;
+	int height;
+	std::string prefix;
+
+	GLuint buffers[2];
+	// the frame each buffer is being read into, -1 if neither
+	int pending[2];
+	int next;
+
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::deque<Frame> queue;
+	// pixel storage the writer has finished with, for reuse
+	std::vector<std::vector<unsigned char> > spare;
+	bool stopping;
+};
+
+#endif
@@ -0,0 +1,239 @@
+#include "frameProfiler.h"
+#include <algorithm>
+#include <cmath>
+
+static const char *stageNames[STAGE_COUNT] = {"display", "upload", "terrain", "hud", "swap", "rise"};
+
+// a frame at 60fps, in ms
+static const double FRAME_BUDGET = 1000.0 / 60;
+
+// returns milliseconds elapsed since start
+static double elapsedMs(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+const char *frameStageName(int stage) {
+	return stageNames[stage];
+}
+
+FrameProfiler::FrameProfiler() {
+	this->timerQueries = false;
+	this->frames = 0;
+	this->started = false;
+	this->historyNext = 0;
+	this->csv = NULL;
+	reset(this->current, 0);
+}
+
+/**
+* The queries aren't deleted: by the time the profiler goes, at exit, the
+* context they belong to may already be gone, and they go with it.
+*/
+FrameProfiler::~FrameProfiler() {
+	if (this->csv) fclose(this->csv);
+}
+
+void FrameProfiler::initGpu() {
+	this->timerQueries = hasTimerQueries();
+}
+
+bool FrameProfiler::openCsv(const char *file) {
+	this->csv = fopen(file, "w");
+	if (!this->csv) return false;
+	fprintf(this->csv, "frame,frame_ms");
+	for (int s = 0; s < STAGE_COUNT; s++) fprintf(this->csv, ",%s_ms", stageNames[s]);
+	for (int s = 0; s < STAGE_COUNT; s++) fprintf(this->csv, ",gpu_%s_ms", stageNames[s]);
+	fprintf(this->csv, "\n");
+	return true;
+}
+
+void FrameProfiler::reset(FrameRecord &record, long frame) {
+	record.frame = frame;
+	record.interval = 0;
+	for (int s = 0; s < STAGE_COUNT; s++) {
+		record.cpu[s] = 0;
+		record.gpu[s] = -1;
+		record.queries[s] = 0;
+	}
+}
+
+/**
+* The time since the last frame started is this frame's interval: it's how
+* often the screen is actually being redrawn.
+*/
+void FrameProfiler::beginFrame() {
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (this->started) this->current.interval = std::chrono::duration<double, std::milli>(now - this->frameStart).count();
+	this->frameStart = now;
+	this->started = true;
+}
+
+void FrameProfiler::endFrame() {
+	this->current.cpu[STAGE_DISPLAY] = elapsedMs(this->frameStart);
+	this->pending.push_back(this->current);
+	reset(this->current, ++this->frames);
+
+	// hand on every frame whose GPU times are in, in order
+	while (!this->pending.empty()) {
+		if (!this->resolve(this->pending.front(), this->pending.size() > (size_t)LATENCY)) break;
+		this->finish(this->pending.front());
+		this->pending.pop_front();
+	}
+}
+
+void FrameProfiler::addCpu(FrameStage stage, double ms) {
+	this->current.cpu[stage] += ms;
+}
+
+bool FrameProfiler::beginGpu(FrameStage stage) {
+	if (!this->timerQueries || this->current.queries[stage]) return false;
+	GLuint query;
+	if (this->freeQueries.empty()) {
+		glGenQueries(1, &query);
+	} else {
+		query = this->freeQueries.back();
+		this->freeQueries.pop_back();
+	}
+	this->current.queries[stage] = query;
+	glBeginQuery(GL_TIME_ELAPSED, query);
+	return true;
+}
+
+void FrameProfiler::endGpu() {
+	glEndQuery(GL_TIME_ELAPSED);
+}
+
+bool FrameProfiler::resolve(FrameRecord &record, bool wait) {
+	if (!wait) {
+		for (int s = 0; s < STAGE_COUNT; s++) {
+			if (!record.queries[s]) continue;
+			GLint available = 0;
+			glGetQueryObjectiv(record.queries[s], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available) return false;
+		}
+	}
+	for (int s = 0; s < STAGE_COUNT; s++) {
+		if (!record.queries[s]) continue;
+		GLuint64 ns = 0;
+		glGetQueryObjectui64v(record.queries[s], GL_QUERY_RESULT, &ns);
+		// some drivers (Mesa's, for one) return nonsense for the first query of a
+		// context, so the first frame isn't timed on the GPU
+		record.gpu[s] = record.frame > 0 ? ns / 1e6 : -1;
+		this->freeQueries.push_back(record.queries[s]);
+		record.queries[s] = 0;
+	}
+	return true;
+}
+
+void FrameProfiler::finish(const FrameRecord &record) {
+	if (this->history.size() < (size_t)HISTORY) {
+		this->history.push_back(record);
+	} else {
+		this->history[this->historyNext] = record;
+		this->historyNext = (this->historyNext + 1) % HISTORY;
+	}
+
+	if (this->csv) {
+		fprintf(this->csv, "%ld,%.3f", record.frame, record.interval);
+		for (int s = 0; s < STAGE_COUNT; s++) fprintf(this->csv, ",%.3f", record.cpu[s]);
+		for (int s = 0; s < STAGE_COUNT; s++) {
+			// left empty where the stage isn't timed on the GPU
+			if (record.gpu[s] < 0) fprintf(this->csv, ",");
+			else fprintf(this->csv, ",%.3f", record.gpu[s]);
+		}
+		fprintf(this->csv, "\n");
+	}
+}
+
+/**
+* The very first frame has no interval, so it's left out of the frame times.
+*/
+FrameStats FrameProfiler::stats() const {
+	FrameStats stats;
+	std::vector<double> intervals;
+	int gpuFrames[STAGE_COUNT];
+	for (int s = 0; s < STAGE_COUNT; s++) {
+		stats.cpu[s] = 0;
+		stats.gpu[s] = 0;
+		gpuFrames[s] = 0;
+	}
+	for (size_t i = 0; i < this->history.size(); i++) {
+		const FrameRecord &record = this->history[i];
+		if (record.interval > 0) intervals.push_back(record.interval);
+		for (int s = 0; s < STAGE_COUNT; s++) {
+			stats.cpu[s] += record.cpu[s];
+			if (record.gpu[s] >= 0) {
+				stats.gpu[s] += record.gpu[s];
+				gpuFrames[s]++;
+			}
+		}
+	}
+	for (int s = 0; s < STAGE_COUNT; s++) {
+		if (!this->history.empty()) stats.cpu[s] /= this->history.size();
+		stats.gpu[s] = gpuFrames[s] ? stats.gpu[s] / gpuFrames[s] : -1;
+	}
+
+	stats.frames = intervals.size();
+	stats.average = stats.p50 = stats.p99 = stats.worst = 0;
+	if (intervals.empty()) return stats;
+	std::sort(intervals.begin(), intervals.end());
+	for (size_t i = 0; i < intervals.size(); i++) stats.average += intervals[i];
+	stats.average /= intervals.size();
+	stats.p50 = intervals[(intervals.size() - 1) / 2];
+	stats.p99 = intervals[(size_t)ceil((intervals.size() - 1) * 0.99)];
+	stats.worst = intervals.back();
+	return stats;
+}
+
+/**
+* One bar per frame, oldest on the left, green while it's within a 60fps
+* frame and red when it isn't. The caller's GL state is left alone.
+*/
+void FrameProfiler::drawGraph(float x0, float y0, float x1, float y1, double maxMs) const {
+	size_t count = this->history.size();
+	float width = (x1 - x0) / HISTORY;
+
+	glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT | GL_COLOR_BUFFER_BIT | GL_POLYGON_BIT);
+	// it's an overlay, so it shouldn't be hidden by whatever is behind it in the depth buffer
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_LIGHTING);
+	glDisable(GL_TEXTURE_2D);
+	glDisable(GL_CULL_FACE);
+	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glBegin(GL_QUADS);
+	for (size_t i = 0; i < count; i++) {
+		const FrameRecord &record = this->history[(this->historyNext + i) % count];
+		double ms = std::min(record.interval, maxMs);
+		if (record.interval > FRAME_BUDGET) glColor4f(0.9, 0.2, 0.2, 0.8);
+		else glColor4f(0.2, 0.8, 0.2, 0.8);
+		float x = x0 + i * width;
+		float y = y0 + (y1 - y0) * (ms / maxMs);
+		glVertex3f(x, y0, 0.0);
+		glVertex3f(x + width, y0, 0.0);
+		glVertex3f(x + width, y, 0.0);
+		glVertex3f(x, y, 0.0);
+	}
+	glEnd();
+
+	// the 60fps line
+	float budget = y0 + (y1 - y0) * std::min(FRAME_BUDGET / maxMs, 1.0);
+	glColor4f(1.0, 1.0, 1.0, 0.8);
+	glBegin(GL_LINES);
+		glVertex3f(x0, budget, 0.0);
+		glVertex3f(x1, budget, 0.0);
+	glEnd();
+	glPopAttrib();
+}
+
+ScopedTimer::ScopedTimer(FrameProfiler &profiler, FrameStage stage, bool gpu) : profiler(profiler) {
+	this->stage = stage;
+	this->gpu = gpu && profiler.beginGpu(stage);
+	this->start = std::chrono::steady_clock::now();
+}
+
+ScopedTimer::~ScopedTimer() {
+	this->profiler.addCpu(this->stage, elapsedMs(this->start));
+	if (this->gpu) this->profiler.endGpu();
+}
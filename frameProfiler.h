@@ -0,0 +1,162 @@
+#ifndef FRAME_PROFILER_H
+#define FRAME_PROFILER_H
+
+#include "glExtensions.h"
+#include <chrono>
+#include <deque>
+#include <vector>
+#include <cstdio>
+
+// the parts of a frame that are timed
+enum FrameStage {
+	// all of display(), from beginFrame() to endFrame()
+	STAGE_DISPLAY = 0,
+	// re-uploading the parts of the terrain that changed
+	STAGE_UPLOAD,
+	// drawing the terrain
+	STAGE_TERRAIN,
+	// drawing the HUD
+	STAGE_HUD,
+	// glutSwapBuffers, which is where waiting for the display shows up
+	// (or, without a window, starting to read the frame back)
+	STAGE_SWAP,
+	// raising the terrain, done between frames
+	STAGE_RISE,
+	STAGE_COUNT
+};
+
+// short name of a stage, as used in the overlay and the CSV header
+const char *frameStageName(int stage);
+
+/**
+* Statistics over the frames the profiler remembers.
+*/
+struct FrameStats {
+	// frames the statistics cover
+	int frames;
+
+	// time from the start of one frame to the start of the next, in ms
+	double average;
+	double p50;
+	double p99;
+	double worst;
+
+	// average ms each stage took on the CPU, and on the GPU (-1 if it isn't timed there)
+	double cpu[STAGE_COUNT];
+	double gpu[STAGE_COUNT];
+};
+
+/**
+* Times the stages of each frame on the CPU, and on the GPU with
+* GL_TIME_ELAPSED queries where the driver has them, and keeps the last
+* HISTORY frames for statistics.
+*
+* GPU results only arrive once the GPU has caught up, so each frame is kept
+* until its queries are ready (waiting for them if it's fallen LATENCY frames
+* behind) before it goes into the history and the CSV file. Only one
+* GL_TIME_ELAPSED query can run at a time, so stages timed on the GPU
+* mustn't overlap.
+*/
+class FrameProfiler {
+public:
+	// frames the statistics cover, 4 seconds at 60fps
+	static const int HISTORY = 240;
+	// frames of GPU queries kept in flight before waiting on them
+	static const int LATENCY = 4;
+
+	FrameProfiler();
+	~FrameProfiler();
+
+	// checks whether the GPU can be timed. needs the context to exist
+	void initGpu();
+
+	// whether GPU stages are being timed
+	bool gpuTiming() const { return this->timerQueries; }
+
+	// writes a line for every frame to file, comma separated with a header.
+	// returns false if it can't be opened.
+	bool openCsv(const char *file);
+
+	// marks the start and end of a frame (the start and end of display())
+	void beginFrame();
+	void endFrame();
+
+	// adds ms of CPU time to a stage of the current frame (see ScopedTimer).
+	// anything timed between frames counts towards the next one
+	void addCpu(FrameStage stage, double ms);
+
+	// starts timing a stage on the GPU, returning false (and doing nothing) without
+	// timer queries, or if the stage was already timed this frame. endGpu() stops it
+	bool beginGpu(FrameStage stage);
+	void endGpu();
+
+	// statistics over the frames in the history
+	FrameStats stats() const;
+
+	// draws the frame times in the history as bars from (x0, y0) to (x1, y1),
+	// where y1 is maxMs, with a line at 60fps. uses the current projection
+	void drawGraph(float x0, float y0, float x1, float y1, double maxMs) const;
+
+private:
+	// the profiler owns the GL queries and the CSV file, so it can't be copied
+	FrameProfiler(const FrameProfiler &other);
+	FrameProfiler &operator=(const FrameProfiler &other);
+
+	struct FrameRecord {
+		long frame;
+		double interval;
+		double cpu[STAGE_COUNT];
+		double gpu[STAGE_COUNT];
+		// the query timing each stage on the GPU, 0 if it isn't
+		GLuint queries[STAGE_COUNT];
+	};
+
+	// clears a record for a new frame
+	static void reset(FrameRecord &record, long frame);
+
+	// reads a record's GPU times if they're ready (or waits for them).
+	// returns false if they aren't ready yet
+	bool resolve(FrameRecord &record, bool wait);
+
+	// puts a finished record into the history and the CSV file
+	void finish(const FrameRecord &record);
+
+	bool timerQueries;
+	// queries that can be reused
+	std::vector<GLuint> freeQueries;
+
+	// the frame being timed, and the frames waiting for their GPU times
+	FrameRecord current;
+	std::deque<FrameRecord> pending;
+	long frames;
+	bool started;
+	std::chrono::steady_clock::time_point frameStart;
+
+	// finished frames. once there are HISTORY of them it's a ring,
+	// with the oldest at historyNext
+	std::vector<FrameRecord> history;
+	size_t historyNext;
+
+	FILE *csv;
+};
+
+/**
+* Times the scope it's in as a stage of the current frame, on the CPU and,
+* if gpu is set and the driver can, on the GPU.
+*/
+class ScopedTimer {
+public:
+	ScopedTimer(FrameProfiler &profiler, FrameStage stage, bool gpu = false);
+	~ScopedTimer();
+
+private:
+	ScopedTimer(const ScopedTimer &other);
+	ScopedTimer &operator=(const ScopedTimer &other);
+
+	FrameProfiler &profiler;
+	FrameStage stage;
+	bool gpu;
+	std::chrono::steady_clock::time_point start;
+};
+
+#endif
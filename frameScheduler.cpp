@@ -0,0 +1,91 @@
+#include "frameScheduler.h"
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+static const char *modeNames[PACING_MODE_COUNT] = {"timer", "vsync", "uncapped"};
+
+// longest gap between frames the simulation catches up on, in seconds
+static const double MAX_GAP = 0.25;
+
+// weight of the newest frame in the average cost
+static const double COST_SMOOTHING = 0.05;
+
+const char *pacingModeName(int mode) {
+	return modeNames[mode];
+}
+
+int pacingModeFromName(const char *name) {
+	for (int i = 0; i < PACING_MODE_COUNT; i++) {
+		if (strcmp(name, modeNames[i]) == 0) return i;
+	}
+	return -1;
+}
+
+FrameScheduler::FrameScheduler(double stepSeconds, double frameSeconds) {
+	this->mMode = PACING_TIMER;
+	this->step = stepSeconds;
+	this->period = frameSeconds;
+	this->accumulator = 0;
+	this->missed = 0;
+	this->frameCost = 0;
+	this->averageCost = 0;
+	this->started = false;
+}
+
+/**
+* Changing mode restarts the schedule, so the switch itself isn't a missed frame.
+*/
+void FrameScheduler::setMode(PacingMode mode) {
+	this->mMode = mode;
+	this->deadline = std::chrono::steady_clock::now();
+}
+
+int FrameScheduler::beginFrame() {
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	this->frameStart = now;
+	if (!this->started) {
+		// the first frame just draws where everything starts
+		this->started = true;
+		this->lastBegin = now;
+		this->deadline = now;
+		return 0;
+	}
+
+	double late = std::chrono::duration<double>(now - this->deadline).count();
+	if (this->mMode != PACING_UNCAPPED && late > this->period / 2) {
+		this->missed++;
+		this->deadline = now;
+	}
+	std::chrono::steady_clock::duration period =
+		std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(this->period));
+	// drawing back to back, the next frame is due a period after this one
+	if (this->mMode == PACING_TIMER) this->deadline += period;
+	else this->deadline = now + period;
+
+	double gap = std::chrono::duration<double>(now - this->lastBegin).count();
+	this->lastBegin = now;
+	this->accumulator += std::min(gap, MAX_GAP);
+	int steps = (int)floor(this->accumulator / this->step);
+	if (steps > MAX_STEPS) {
+		// drop what can't be caught up on
+		steps = MAX_STEPS;
+		this->accumulator = 0;
+	} else {
+		this->accumulator -= steps * this->step;
+	}
+	return steps;
+}
+
+void FrameScheduler::endFrame() {
+	this->frameCost = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - this->frameStart).count();
+	if (this->averageCost == 0) this->averageCost = this->frameCost;
+	else this->averageCost += (this->frameCost - this->averageCost) * COST_SMOOTHING;
+}
+
+int FrameScheduler::delayMs() const {
+	if (this->mMode != PACING_TIMER) return 0;
+	double ms = std::chrono::duration<double, std::milli>(this->deadline - std::chrono::steady_clock::now()).count();
+	// timers fire late more often than early, so round down
+	return ms > 0 ? (int)ms : 0;
+}
@@ -0,0 +1,85 @@
+#ifndef FRAME_SCHEDULER_H
+#define FRAME_SCHEDULER_H
+
+#include <chrono>
+
+// how frames are paced
+enum PacingMode {
+	// a timer wakes the loop up for each frame, allowing for how long the last one took
+	PACING_TIMER = 0,
+	// frames are drawn back to back and the buffer swap waits for the display
+	PACING_VSYNC,
+	// frames are drawn back to back without waiting for anything, for benchmarking
+	PACING_UNCAPPED,
+	PACING_MODE_COUNT
+};
+
+// name of a pacing mode, as used on the command line and the HUD
+const char *pacingModeName(int mode);
+
+// the pacing mode with the given name, or -1 if there isn't one
+int pacingModeFromName(const char *name);
+
+/**
+* Decides when frames are drawn and how far the simulation moves for each.
+*
+* The simulation runs in fixed steps of stepSeconds, however often frames
+* are drawn: each frame runs however many steps have come due since the last
+* one, and alpha() says how far it is between the last two steps, so what's
+* drawn can be interpolated between them. Long stalls are capped at
+* MAX_STEPS so the simulation can't fall further and further behind.
+*
+* In timer mode the next frame is due a frame period after the last one was,
+* and delayMs() is whatever is left of that after the frame's own cost. With
+* vsync, each frame is due a period after the one before it started. A frame
+* that starts more than half a period late has missed its deadline, and the
+* schedule restarts from it rather than rushing to catch up.
+*/
+class FrameScheduler {
+public:
+	// most steps run for a single frame
+	static const int MAX_STEPS = 8;
+
+	FrameScheduler(double stepSeconds, double frameSeconds);
+
+	PacingMode mode() const { return this->mMode; }
+	void setMode(PacingMode mode);
+
+	// starts a frame, returning the number of simulation steps to run for it
+	int beginFrame();
+
+	// ends the frame, once it's been swapped to the screen
+	void endFrame();
+
+	// how far the frame is between the last two simulation steps, from 0 to 1
+	double alpha() const { return this->accumulator / this->step; }
+
+	// ms to wait before the next frame in timer mode
+	int delayMs() const;
+
+	// how long the simulation steps are, in seconds
+	double stepSeconds() const { return this->step; }
+
+	// frames that started more than half a period late (not counted when uncapped)
+	long missed;
+
+	// ms from the start of the last frame to its end, and a running average of it
+	double frameCost;
+	double averageCost;
+
+private:
+	PacingMode mMode;
+	double step;
+	double period;
+
+	// seconds of simulation that are due but haven't been stepped yet
+	double accumulator;
+
+	bool started;
+	std::chrono::steady_clock::time_point lastBegin;
+	std::chrono::steady_clock::time_point frameStart;
+	// when the next frame is due, in timer mode
+	std::chrono::steady_clock::time_point deadline;
+};
+
+#endif
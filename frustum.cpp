@@ -0,0 +1,55 @@
+#include "frustum.h"
+#include <cmath>
+
+Frustum::Frustum() {
+	// everything is inside an empty set of planes
+	for (int i = 0; i < 6; i++) {
+		for (int j = 0; j < 4; j++) this->planes[i][j] = 0;
+	}
+}
+
+// sets a plane through point p with inward normal n
+static void setPlane(float plane[4], Vec3D n, Vec3D p) {
+	n = n.normalize();
+	plane[0] = n.mX;
+	plane[1] = n.mY;
+	plane[2] = n.mZ;
+	plane[3] = -(n.mX*p.mX + n.mY*p.mY + n.mZ*p.mZ);
+}
+
+/**
+* The side planes all go through the camera. Each one's normal is tilted from
+* the view direction so it's perpendicular to the edge of the view on that side.
+*/
+Frustum::Frustum(Vec3D pos, Vec3D front, Vec3D up, float fovY, float aspect, float zNear, float zFar) {
+	Vec3D f = front.normalize();
+	Vec3D r = f.cross(up).normalize();
+	Vec3D u = r.cross(f);
+	float tv = tanf(fovY * 3.14159265f / 360);
+	float th = tv * aspect;
+
+	setPlane(this->planes[0], f, Vec3D(pos.mX + f.mX*zNear, pos.mY + f.mY*zNear, pos.mZ + f.mZ*zNear));
+	setPlane(this->planes[1], f.multiply(-1), Vec3D(pos.mX + f.mX*zFar, pos.mY + f.mY*zFar, pos.mZ + f.mZ*zFar));
+	Vec3D ft = f.multiply(th);
+	setPlane(this->planes[2], Vec3D(ft.mX + r.mX, ft.mY + r.mY, ft.mZ + r.mZ), pos);
+	setPlane(this->planes[3], Vec3D(ft.mX - r.mX, ft.mY - r.mY, ft.mZ - r.mZ), pos);
+	ft = f.multiply(tv);
+	setPlane(this->planes[4], Vec3D(ft.mX + u.mX, ft.mY + u.mY, ft.mZ + u.mZ), pos);
+	setPlane(this->planes[5], Vec3D(ft.mX - u.mX, ft.mY - u.mY, ft.mZ - u.mZ), pos);
+}
+
+/**
+* For each plane, the corner of the box furthest along its normal decides if
+* the box is completely outside, and the nearest corner if it's completely inside.
+*/
+Frustum::Test Frustum::testBox(float minX, float minY, float minZ, float maxX, float maxY, float maxZ) const {
+	Test result = INSIDE;
+	for (int i = 0; i < 6; i++) {
+		const float *p = this->planes[i];
+		float outer = p[0] * (p[0] > 0 ? maxX : minX) + p[1] * (p[1] > 0 ? maxY : minY) + p[2] * (p[2] > 0 ? maxZ : minZ) + p[3];
+		if (outer < 0) return OUTSIDE;
+		float inner = p[0] * (p[0] > 0 ? minX : maxX) + p[1] * (p[1] > 0 ? minY : maxY) + p[2] * (p[2] > 0 ? minZ : maxZ) + p[3];
+		if (inner < 0) result = INTERSECTS;
+	}
+	return result;
+}
@@ -0,0 +1,31 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include "mathLib3D.h"
+
+/**
+* The volume a perspective camera can see, as six planes facing inwards.
+*/
+class Frustum {
+public:
+	// results of testing a box against the frustum
+	enum Test {
+		OUTSIDE,
+		INTERSECTS,
+		INSIDE
+	};
+
+	Frustum();
+
+	// the frustum of a camera at pos looking along front (with up roughly above it),
+	// with the same parameters as gluPerspective
+	Frustum(Vec3D pos, Vec3D front, Vec3D up, float fovY, float aspect, float zNear, float zFar);
+
+	// tests the axis-aligned box from (minX, minY, minZ) to (maxX, maxY, maxZ)
+	Test testBox(float minX, float minY, float minZ, float maxX, float maxY, float maxZ) const;
+
+	// each plane is a*x + b*y + c*z + d >= 0 on the inside
+	float planes[6][4];
+};
+
+#endif
@@ -0,0 +1,109 @@
+#include "glExtensions.h"
+#include <cstring>
+#include <cstdio>
+#if defined(__APPLE__)
+#include <OpenGL/OpenGL.h>
+#elif !defined(_WIN32)
+#include <GL/glx.h>
+#endif
+
+#ifdef _WIN32
+PFNGLGENBUFFERSPROC glGenBuffers;
+PFNGLDELETEBUFFERSPROC glDeleteBuffers;
+PFNGLBINDBUFFERPROC glBindBuffer;
+PFNGLBUFFERDATAPROC glBufferData;
+PFNGLBUFFERSUBDATAPROC glBufferSubData;
+PFNGLMULTIDRAWELEMENTSPROC glMultiDrawElements;
+PFNGLMAPBUFFERPROC glMapBuffer;
+PFNGLUNMAPBUFFERPROC glUnmapBuffer;
+PFNGLGENQUERIESPROC glGenQueries;
+PFNGLDELETEQUERIESPROC glDeleteQueries;
+PFNGLBEGINQUERYPROC glBeginQuery;
+PFNGLENDQUERYPROC glEndQuery;
+PFNGLGETQUERYOBJECTIVPROC glGetQueryObjectiv;
+PFNGLGETQUERYOBJECTUI64VPROC glGetQueryObjectui64v;
+
+// looks up a single entry point, returning false if it's missing
+template <typename T>
+static bool load(T &function, const char *name) {
+	function = reinterpret_cast<T>(wglGetProcAddress(name));
+	return function != NULL;
+}
+#endif
+
+/**
+* Loads the GL entry points that aren't exported by the system GL library.
+* On Linux and OS X they're linked directly, so there's nothing to do.
+*/
+bool loadGLExtensions() {
+#ifdef _WIN32
+	bool ok = true;
+	ok = load(glGenBuffers, "glGenBuffers") && ok;
+	ok = load(glDeleteBuffers, "glDeleteBuffers") && ok;
+	ok = load(glBindBuffer, "glBindBuffer") && ok;
+	ok = load(glBufferData, "glBufferData") && ok;
+	ok = load(glBufferSubData, "glBufferSubData") && ok;
+	ok = load(glMultiDrawElements, "glMultiDrawElements") && ok;
+	ok = load(glMapBuffer, "glMapBuffer") && ok;
+	ok = load(glUnmapBuffer, "glUnmapBuffer") && ok;
+	ok = load(glGenQueries, "glGenQueries") && ok;
+	ok = load(glDeleteQueries, "glDeleteQueries") && ok;
+	ok = load(glBeginQuery, "glBeginQuery") && ok;
+	ok = load(glEndQuery, "glEndQuery") && ok;
+	ok = load(glGetQueryObjectiv, "glGetQueryObjectiv") && ok;
+	// optional, see hasTimerQueries()
+	if (!load(glGetQueryObjectui64v, "glGetQueryObjectui64v")) load(glGetQueryObjectui64v, "glGetQueryObjectui64vEXT");
+	return ok;
+#else
+	return true;
+#endif
+}
+
+/**
+* Checks the version first, then the extension list (which is only there
+* in compatibility contexts, as GLUT creates).
+*/
+bool hasTimerQueries() {
+#ifdef _WIN32
+	if (!glGetQueryObjectui64v) return false;
+#endif
+	int major = 0, minor = 0;
+	const char *version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+	if (version && sscanf(version, "%d.%d", &major, &minor) == 2 && (major > 3 || (major == 3 && minor >= 3))) return true;
+	const char *extensions = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+	if (!extensions) return false;
+	return strstr(extensions, "GL_ARB_timer_query") != NULL || strstr(extensions, "GL_EXT_timer_query") != NULL;
+}
+
+/**
+* Each platform has its own extension for this. On X there are three, which
+* are tried in turn: EXT and MESA can turn syncing off, SGI can't.
+*/
+bool setSwapInterval(int interval) {
+#if defined(__APPLE__)
+	GLint value = interval;
+	return CGLSetParameter(CGLGetCurrentContext(), kCGLCPSwapInterval, &value) == kCGLNoError;
+#elif defined(_WIN32)
+	typedef BOOL (WINAPI *SwapIntervalProc)(int);
+	SwapIntervalProc swapInterval = reinterpret_cast<SwapIntervalProc>(wglGetProcAddress("wglSwapIntervalEXT"));
+	return swapInterval && swapInterval(interval);
+#else
+	typedef void (*SwapIntervalEXTProc)(Display*, GLXDrawable, int);
+	typedef int (*SwapIntervalProc)(int);
+	SwapIntervalEXTProc swapIntervalEXT = reinterpret_cast<SwapIntervalEXTProc>(
+		glXGetProcAddressARB(reinterpret_cast<const GLubyte*>("glXSwapIntervalEXT")));
+	Display *display = glXGetCurrentDisplay();
+	GLXDrawable drawable = glXGetCurrentDrawable();
+	if (swapIntervalEXT && display && drawable) {
+		swapIntervalEXT(display, drawable, interval);
+		return true;
+	}
+	SwapIntervalProc swapIntervalMESA = reinterpret_cast<SwapIntervalProc>(
+		glXGetProcAddressARB(reinterpret_cast<const GLubyte*>("glXSwapIntervalMESA")));
+	if (swapIntervalMESA) return swapIntervalMESA(interval) == 0;
+	SwapIntervalProc swapIntervalSGI = reinterpret_cast<SwapIntervalProc>(
+		glXGetProcAddressARB(reinterpret_cast<const GLubyte*>("glXSwapIntervalSGI")));
+	if (swapIntervalSGI && interval > 0) return swapIntervalSGI(interval) == 0;
+	return false;
+#endif
+}
@@ -0,0 +1,64 @@
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+// GL headers, plus the post-1.1 entry points (buffer objects etc.) we use.
+// this has to be included before anything else includes GL/gl.h, otherwise
+// the prototypes below won't be declared.
+#ifdef __APPLE__
+#include <OpenGL/gl.h>
+#include <OpenGL/glu.h>
+#include <GLUT/glut.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include <GL/glu.h>
+#include <GL/freeglut.h>
+#else
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include <GL/glu.h>
+#include <GL/freeglut.h>
+#endif
+
+#ifdef _WIN32
+// windows only exports GL 1.1, everything newer is loaded at runtime
+extern PFNGLGENBUFFERSPROC glGenBuffers;
+extern PFNGLDELETEBUFFERSPROC glDeleteBuffers;
+extern PFNGLBINDBUFFERPROC glBindBuffer;
+extern PFNGLBUFFERDATAPROC glBufferData;
+extern PFNGLBUFFERSUBDATAPROC glBufferSubData;
+extern PFNGLMULTIDRAWELEMENTSPROC glMultiDrawElements;
+extern PFNGLMAPBUFFERPROC glMapBuffer;
+extern PFNGLUNMAPBUFFERPROC glUnmapBuffer;
+extern PFNGLGENQUERIESPROC glGenQueries;
+extern PFNGLDELETEQUERIESPROC glDeleteQueries;
+extern PFNGLBEGINQUERYPROC glBeginQuery;
+extern PFNGLENDQUERYPROC glEndQuery;
+extern PFNGLGETQUERYOBJECTIVPROC glGetQueryObjectiv;
+// only there with timer queries, NULL otherwise
+extern PFNGLGETQUERYOBJECTUI64VPROC glGetQueryObjectui64v;
+#endif
+
+#ifdef __APPLE__
+// the legacy GL on OS X only has timer queries as an extension
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED GL_TIME_ELAPSED_EXT
+#endif
+#define glGetQueryObjectui64v glGetQueryObjectui64vEXT
+#endif
+
+// loads the entry points above where needed. must be called once a context exists.
+// returns false if the driver doesn't provide them.
+bool loadGLExtensions();
+
+// whether GL_TIME_ELAPSED queries can be used to time work on the GPU
+// (GL 3.3, or the ARB or EXT timer query extension)
+bool hasTimerQueries();
+
+// asks for buffer swaps to wait for interval vertical syncs (0 to not wait at all).
+// returns false if the platform has no way to set it
+bool setSwapInterval(int interval);
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include <cstdlib>
+#include <cstddef>
+#include <new>
+#include <utility>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+// alignment (in bytes) of the start of grid storage, a cache line so the grid doesn't share
+// its first line with anything else. rows aren't padded, so later rows are only aligned when
+// z_size * sizeof(T) is a multiple of it, and the SIMD kernels use unaligned loads
+#define GRID_ALIGNMENT 64
+
+/**
+* A 2D grid of values stored in one contiguous, aligned block.
+* Indexed as grid(x, z), laid out row-major so that z is the fast axis
+* (the same order the old grid[x][z] arrays were walked in).
+*
+* The storage is kept when the grid is resized to a size that fits in it,
+* so regenerating a terrain of the same size doesn't reallocate anything.
+*/
+template <typename T>
+class Grid {
+public:
+	Grid() {
+		this->x_size = 0;
+		this->z_size = 0;
+		this->mData = NULL;
+		this->mCapacity = 0;
+	}
+
+	~Grid() {
+		this->release();
+	}
+
+	// size of the grid x, z
+	int x_size;
+	int z_size;
+
+	/**
+	* Resizes the grid to x_size * z_size.
+	* Existing storage is reused if it's big enough; contents are not preserved.
+	*/
+	void resize(int x_size, int z_size) {
+		size_t count = (size_t)x_size * (size_t)z_size;
+		if (count > this->mCapacity) {
+			this->release();
+			this->mData = allocateAligned(count);
+			this->mCapacity = count;
+		}
+		this->x_size = x_size;
+		this->z_size = z_size;
+	}
+
+	// frees the storage
+	void release() {
+		if (this->mData) {
+			for (size_t i = 0; i < this->mCapacity; i++) this->mData[i].~T();
+			freeAligned(this->mData);
+		}
+		this->mData = NULL;
+		this->mCapacity = 0;
+		this->x_size = 0;
+		this->z_size = 0;
+	}
+
+	// exchanges the contents (and storage) of two grids without copying anything
+	void swap(Grid &other) {
+		std::swap(this->x_size, other.x_size);
+		std::swap(this->z_size, other.z_size);
+		std::swap(this->mData, other.mData);
+		std::swap(this->mCapacity, other.mCapacity);
+	}
+
+	// sets every value in the grid
+	void fill(const T &value) {
+		size_t count = this->size();
+		for (size_t i = 0; i < count; i++) this->mData[i] = value;
+	}
+
+	// element access
+	T &operator()(int x, int z) { return this->mData[(size_t)x * this->z_size + z]; }
+	const T &operator()(int x, int z) const { return this->mData[(size_t)x * this->z_size + z]; }
+
+	// pointer to the start of row x (all of the z values for that x)
+	T *row(int x) { return this->mData + (size_t)x * this->z_size; }
+	const T *row(int x) const { return this->mData + (size_t)x * this->z_size; }
+
+	// the whole grid as one array
+	T *data() { return this->mData; }
+	const T *data() const { return this->mData; }
+
+	// number of values in the grid
+	size_t size() const { return (size_t)this->x_size * (size_t)this->z_size; }
+
+private:
+	// the grid owns its storage, so it can't be copied
+	Grid(const Grid &other);
+	Grid &operator=(const Grid &other);
+
+	// allocates and default constructs count values, aligned to GRID_ALIGNMENT
+	static T *allocateAligned(size_t count) {
+		void *mem = NULL;
+#ifdef _WIN32
+		mem = _aligned_malloc(count * sizeof(T), GRID_ALIGNMENT);
+#else
+		if (posix_memalign(&mem, GRID_ALIGNMENT, count * sizeof(T)) != 0) mem = NULL;
+#endif
+		if (!mem) throw std::bad_alloc();
+		T *data = static_cast<T*>(mem);
+		for (size_t i = 0; i < count; i++) new (data + i) T();
+		return data;
+	}
+
+	static void freeAligned(T *data) {
+#ifdef _WIN32
+		_aligned_free(data);
+#else
+		free(data);
+#endif
+	}
+
+	T *mData;
+	size_t mCapacity;
+};
+
+#endif
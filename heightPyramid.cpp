@@ -0,0 +1,84 @@
+#include "heightPyramid.h"
+#include <algorithm>
+#include <cstring>
+
+HeightPyramid::HeightPyramid() {}
+
+HeightPyramid::~HeightPyramid() {
+	this->release();
+}
+
+void HeightPyramid::release() {
+	for (size_t i = 0; i < this->levels.size(); i++) delete this->levels[i];
+	this->levels.clear();
+}
+
+/**
+* Allocates the levels (reusing them if the size hasn't changed) and fills them all in.
+*/
+void HeightPyramid::build(const Grid<float> &heights) {
+	bool sameSize = !this->levels.empty() &&
+		this->levels[0]->x_size == heights.x_size && this->levels[0]->z_size == heights.z_size;
+	if (!sameSize) {
+		this->release();
+		int x_size = heights.x_size;
+		int z_size = heights.z_size;
+		if (x_size <= 0 || z_size <= 0) return;
+		while (true) {
+			Grid<float> *level = new Grid<float>();
+			level->resize(x_size, z_size);
+			this->levels.push_back(level);
+			if (x_size == 1 && z_size == 1) break;
+			x_size = (x_size + 1) / 2;
+			z_size = (z_size + 1) / 2;
+		}
+	}
+	this->update(heights, 0, 0, heights.x_size, heights.z_size);
+}
+
+/**
+* Copies the region into level 0, then works up the levels, each time
+* recomputing only the cells that have a changed cell beneath them.
+*/
+void HeightPyramid::update(const Grid<float> &heights, int x0, int z0, int x1, int z1) {
+	if (this->levels.empty()) return;
+	x0 = std::max(x0, 0);
+	z0 = std::max(z0, 0);
+	x1 = std::min(x1, heights.x_size);
+	z1 = std::min(z1, heights.z_size);
+	if (x0 >= x1 || z0 >= z1) return;
+
+	Grid<float> &base = *this->levels[0];
+	for (int x = x0; x < x1; x++) {
+		memcpy(base.row(x) + z0, heights.row(x) + z0, (z1 - z0) * sizeof(float));
+	}
+
+	for (size_t l = 1; l < this->levels.size(); l++) {
+		const Grid<float> &below = *this->levels[l-1];
+		Grid<float> &level = *this->levels[l];
+
+		// the cells of this level covering the changed region of the one below
+		x0 = x0 / 2;
+		z0 = z0 / 2;
+		x1 = (x1 + 1) / 2;
+		z1 = (z1 + 1) / 2;
+
+		for (int x = x0; x < x1; x++) {
+			const float *a = below.row(2*x);
+			// on an odd sized level the last cell only has one row (or column) under it
+			const float *b = (2*x + 1 < below.x_size) ? below.row(2*x + 1) : a;
+			float *out = level.row(x);
+			for (int z = z0; z < z1; z++) {
+				int z2 = (2*z + 1 < below.z_size) ? 2*z + 1 : 2*z;
+				out[z] = std::max(std::max(a[2*z], a[z2]), std::max(b[2*z], b[z2]));
+			}
+		}
+	}
+}
+
+int HeightPyramid::levelFitting(int x_size, int z_size) const {
+	for (size_t l = 0; l < this->levels.size(); l++) {
+		if (this->levels[l]->x_size <= x_size && this->levels[l]->z_size <= z_size) return l;
+	}
+	return this->levels.size() - 1;
+}
@@ -0,0 +1,48 @@
+#ifndef HEIGHT_PYRAMID_H
+#define HEIGHT_PYRAMID_H
+
+#include "grid.h"
+#include <vector>
+
+/**
+* A max-mip pyramid of a heightmap. Level 0 is a copy of the heights, and
+* each level above it is half the size (rounded up) of the one below, with
+* every cell holding the highest of the (up to) 2x2 cells under it. The top
+* level is a single cell with the highest point of the whole map.
+*
+* Only the part of the pyramid above a changed region needs to be redone,
+* so small edits stay cheap.
+*/
+class HeightPyramid {
+public:
+	HeightPyramid();
+	~HeightPyramid();
+
+	// resizes the pyramid to match heights and rebuilds every level
+	void build(const Grid<float> &heights);
+
+	// recomputes the cells covering rows [x0, x1) and columns [z0, z1) of heights,
+	// which has to be the same size the pyramid was built for
+	void update(const Grid<float> &heights, int x0, int z0, int x1, int z1);
+
+	// number of levels, including level 0
+	int levelCount() const { return this->levels.size(); }
+
+	// the max heights at a level, each cell covers 2^level x 2^level heights
+	const Grid<float> &level(int index) const { return *this->levels[index]; }
+
+	// the lowest (most detailed) level that is no bigger than x_size by z_size
+	int levelFitting(int x_size, int z_size) const;
+
+	// frees all of the levels
+	void release();
+
+private:
+	// the pyramid owns its grids, so it can't be copied
+	HeightPyramid(const HeightPyramid &other);
+	HeightPyramid &operator=(const HeightPyramid &other);
+
+	std::vector<Grid<float>*> levels;
+};
+
+#endif
@@ -0,0 +1,264 @@
+#include "heightQuery.h"
+#include <algorithm>
+#include <cmath>
+
+// the deepest a quadtree can get, enough for grids 2^31 on a side
+static const int MAX_LEVELS = 32;
+
+HeightQuery::HeightQuery() {
+	this->grid = NULL;
+	this->nodesVisited = 0;
+}
+
+HeightQuery::~HeightQuery() {
+	this->release();
+}
+
+void HeightQuery::release() {
+	for (size_t i = 0; i < this->levels.size(); i++) delete this->levels[i];
+	this->levels.clear();
+}
+
+/**
+* Level 0 takes each cell's range from its four corners, since the bilinear
+* surface never goes outside them. Levels are reused if the size hasn't changed.
+*/
+void HeightQuery::build(const Grid<float> &heights) {
+	this->grid = &heights;
+	int x_size = heights.x_size - 1;
+	int z_size = heights.z_size - 1;
+	if (x_size < 1 || z_size < 1) {
+		this->release();
+		return;
+	}
+	if (this->levels.empty() || this->levels[0]->x_size != x_size || this->levels[0]->z_size != z_size) {
+		this->release();
+		int nx = x_size, nz = z_size;
+		while (true) {
+			Grid<HeightRange> *level = new Grid<HeightRange>();
+			level->resize(nx, nz);
+			this->levels.push_back(level);
+			if (nx == 1 && nz == 1) break;
+			nx = (nx + 1) / 2;
+			nz = (nz + 1) / 2;
+		}
+	}
+
+	Grid<HeightRange> &cells = *this->levels[0];
+	for (int x = 0; x < x_size; x++) {
+		const float *a = heights.row(x);
+		const float *b = heights.row(x + 1);
+		HeightRange *out = cells.row(x);
+		for (int z = 0; z < z_size; z++) {
+			out[z].min = std::min(std::min(a[z], a[z + 1]), std::min(b[z], b[z + 1]));
+			out[z].max = std::max(std::max(a[z], a[z + 1]), std::max(b[z], b[z + 1]));
+		}
+	}
+
+	for (size_t l = 1; l < this->levels.size(); l++) {
+		const Grid<HeightRange> &below = *this->levels[l-1];
+		Grid<HeightRange> &level = *this->levels[l];
+		for (int x = 0; x < level.x_size; x++) {
+			// on an odd sized level the last node only has one row (or column) under it
+			int x2 = std::min(2*x + 1, below.x_size - 1);
+			for (int z = 0; z < level.z_size; z++) {
+				int z2 = std::min(2*z + 1, below.z_size - 1);
+				const HeightRange &r0 = below(2*x, 2*z), &r1 = below(2*x, z2);
+				const HeightRange &r2 = below(x2, 2*z), &r3 = below(x2, z2);
+				level(x, z).min = std::min(std::min(r0.min, r1.min), std::min(r2.min, r3.min));
+				level(x, z).max = std::max(std::max(r0.max, r1.max), std::max(r2.max, r3.max));
+			}
+		}
+	}
+}
+
+bool HeightQuery::contains(float x, float z) const {
+	return this->grid && x >= 0 && z >= 0 && x <= this->grid->x_size - 1 && z <= this->grid->z_size - 1;
+}
+
+float HeightQuery::height(float x, float z) const {
+	const Grid<float> &heights = *this->grid;
+	float maxX = heights.x_size - 1;
+	float maxZ = heights.z_size - 1;
+	x = std::min(std::max(x, 0.0f), maxX);
+	z = std::min(std::max(z, 0.0f), maxZ);
+	// the last row and column of points are the far corners of the cells before them
+	int cx = std::min((int)x, heights.x_size - 2);
+	int cz = std::min((int)z, heights.z_size - 2);
+	float u = x - cx;
+	float v = z - cz;
+	const float *a = heights.row(cx) + cz;
+	const float *b = heights.row(cx + 1) + cz;
+	float near = a[0] + (a[1] - a[0]) * v;
+	float far = b[0] + (b[1] - b[0]) * v;
+	return near + (far - near) * u;
+}
+
+/**
+* The same as height(), with the bounds hoisted out of the loop.
+*/
+void HeightQuery::heights(const float *x, const float *z, int count, float *out) const {
+	const Grid<float> &heights = *this->grid;
+	const float maxX = heights.x_size - 1;
+	const float maxZ = heights.z_size - 1;
+	const int lastX = heights.x_size - 2;
+	const int lastZ = heights.z_size - 2;
+	const int stride = heights.z_size;
+	const float *data = heights.data();
+	for (int i = 0; i < count; i++) {
+		float px = std::min(std::max(x[i], 0.0f), maxX);
+		float pz = std::min(std::max(z[i], 0.0f), maxZ);
+		int cx = std::min((int)px, lastX);
+		int cz = std::min((int)pz, lastZ);
+		float u = px - cx;
+		float v = pz - cz;
+		const float *a = data + (size_t)cx * stride + cz;
+		const float *b = a + stride;
+		float near = a[0] + (a[1] - a[0]) * v;
+		float far = b[0] + (b[1] - b[0]) * v;
+		out[i] = near + (far - near) * u;
+	}
+}
+
+/**
+* Along the ray the surface is a quadratic in t (the bilinear uv term makes
+* it one), so the ray's height above it is too, and the first root inside
+* [t0, t1] is the hit.
+*/
+bool HeightQuery::hitCell(int cx, int cz, const double origin[3], const double direction[3], double t0, double t1, double &t) const {
+	const Grid<float> &heights = *this->grid;
+	double h00 = heights(cx, cz), h10 = heights(cx + 1, cz);
+	double h01 = heights(cx, cz + 1), h11 = heights(cx + 1, cz + 1);
+	double b = h10 - h00, c = h01 - h00, d = h00 - h10 - h01 + h11;
+	double u0 = origin[0] - cx, v0 = origin[2] - cz;
+	double du = direction[0], dv = direction[2];
+
+	// ray height - surface height = qa t^2 + qb t + qc
+	double qa = -d * du * dv;
+	double qb = direction[1] - (b * du + c * dv + d * (u0 * dv + v0 * du));
+	double qc = origin[1] - (h00 + b * u0 + c * v0 + d * u0 * v0);
+
+	double roots[2];
+	int count = 0;
+	if (fabs(qa) < 1e-12) {
+		if (qb != 0) roots[count++] = -qc / qb;
+	} else {
+		double discriminant = qb * qb - 4 * qa * qc;
+		if (discriminant < 0) return false;
+		// the form that doesn't cancel out
+		double q = -0.5 * (qb + (qb < 0 ? -sqrt(discriminant) : sqrt(discriminant)));
+		roots[count++] = q / qa;
+		if (q != 0) roots[count++] = qc / q;
+		if (count == 2 && roots[1] < roots[0]) std::swap(roots[0], roots[1]);
+	}
+	// a little slack either side, so a hit right on a cell's edge isn't lost between the two cells
+	const double slack = 1e-9 * (1 + t1);
+	for (int i = 0; i < count; i++) {
+		if (roots[i] >= t0 - slack && roots[i] <= t1 + slack) {
+			t = std::min(std::max(roots[i], t0), t1);
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+* Nodes wait on a stack with the part of the ray that's over them. Each node
+* popped is checked against its height range, and its children are pushed
+* furthest first, so the first cell hit is the nearest.
+*/
+bool HeightQuery::intersect(const Vec3D &origin, const Vec3D &direction, float maxT, RayHit &hit) const {
+	this->nodesVisited = 0;
+	if (this->levels.empty()) return false;
+	const double o[3] = {origin.mX, origin.mY, origin.mZ};
+	const double d[3] = {direction.mX, direction.mY, direction.mZ};
+	// the slabs divide by the direction a lot, so it's done once here
+	const double inv[3] = {d[0] != 0 ? 1 / d[0] : 0, 0, d[2] != 0 ? 1 / d[2] : 0};
+	const double xEnd = this->grid->x_size - 1;
+	const double zEnd = this->grid->z_size - 1;
+
+	struct Node {
+		int level, x, z;
+		double t0, t1;
+	};
+	Node stack[4 * MAX_LEVELS];
+	int top = 0;
+
+	// the part of [t0, t1] where the ray is over the box [x0, x1] x [z0, z1], false if there's none
+	struct Slab {
+		static bool clip(const double o[3], const double d[3], const double inv[3], double x0, double x1, double z0, double z1,
+				double &t0, double &t1) {
+			if (d[0] != 0) {
+				double a = (x0 - o[0]) * inv[0], b = (x1 - o[0]) * inv[0];
+				t0 = std::max(t0, std::min(a, b));
+				t1 = std::min(t1, std::max(a, b));
+			} else if (o[0] < x0 || o[0] > x1) return false;
+			if (d[2] != 0) {
+				double a = (z0 - o[2]) * inv[2], b = (z1 - o[2]) * inv[2];
+				t0 = std::max(t0, std::min(a, b));
+				t1 = std::min(t1, std::max(a, b));
+			} else if (o[2] < z0 || o[2] > z1) return false;
+			return t0 <= t1;
+		}
+	};
+
+	Node root;
+	root.level = this->levels.size() - 1;
+	root.x = 0;
+	root.z = 0;
+	root.t0 = 0;
+	root.t1 = maxT;
+	if (!Slab::clip(o, d, inv, 0, xEnd, 0, zEnd, root.t0, root.t1)) return false;
+	stack[top++] = root;
+
+	while (top > 0) {
+		Node node = stack[--top];
+		this->nodesVisited++;
+		const HeightRange &range = (*this->levels[node.level])(node.x, node.z);
+		double y0 = o[1] + d[1] * node.t0;
+		double y1 = o[1] + d[1] * node.t1;
+		if (std::min(y0, y1) > range.max || std::max(y0, y1) < range.min) continue;
+
+		if (node.level == 0) {
+			double t;
+			if (this->hitCell(node.x, node.z, o, d, node.t0, node.t1, t)) {
+				hit.t = t;
+				hit.x = o[0] + d[0] * t;
+				hit.y = o[1] + d[1] * t;
+				hit.z = o[2] + d[2] * t;
+				return true;
+			}
+			continue;
+		}
+
+		// the children the ray passes over, sorted so the nearest ends up on top of the stack
+		const Grid<HeightRange> &below = *this->levels[node.level - 1];
+		int size = 1 << (node.level - 1);
+		Node children[4];
+		int count = 0;
+		for (int i = 0; i < 2; i++) {
+			int cx = node.x * 2 + i;
+			if (cx >= below.x_size) continue;
+			for (int j = 0; j < 2; j++) {
+				int cz = node.z * 2 + j;
+				if (cz >= below.z_size) continue;
+				Node child;
+				child.level = node.level - 1;
+				child.x = cx;
+				child.z = cz;
+				child.t0 = node.t0;
+				child.t1 = node.t1;
+				double x0 = (double)cx * size, z0 = (double)cz * size;
+				if (!Slab::clip(o, d, inv, x0, std::min(x0 + size, xEnd), z0, std::min(z0 + size, zEnd), child.t0, child.t1)) continue;
+				int k = count++;
+				while (k > 0 && children[k-1].t0 < child.t0) {
+					children[k] = children[k-1];
+					k--;
+				}
+				children[k] = child;
+			}
+		}
+		for (int i = 0; i < count; i++) stack[top++] = children[i];
+	}
+	return false;
+}
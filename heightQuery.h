@@ -0,0 +1,82 @@
+#ifndef HEIGHT_QUERY_H
+#define HEIGHT_QUERY_H
+
+#include "grid.h"
+#include "mathLib3D.h"
+#include <vector>
+
+/**
+* Where a ray met the ground: the point, and how far along the ray it is
+* (in lengths of the ray's direction).
+*/
+struct RayHit {
+	float x, y, z;
+	float t;
+};
+
+/**
+* Answers questions about the ground of a heightmap: how high it is at any
+* (x, z), and where a ray first meets it.
+*
+* Between the grid points the ground is the bilinear blend of a cell's four
+* corners, for sampling and intersection alike. Rays are intersected using a
+* min/max quadtree of the cells: a node is only looked inside if the part of
+* the ray over it passes between its lowest and highest point, and its
+* children are tried nearest first, so a query visits a few nodes per level
+* instead of every cell under the ray.
+*
+* The query keeps a pointer to the heights it was built from. They can keep
+* changing for sampling, but the quadtree only matches them as they were at
+* build(), so it has to be built again for intersections to see changes.
+*/
+class HeightQuery {
+public:
+	HeightQuery();
+	~HeightQuery();
+
+	// builds the quadtree for heights (which need to be at least 2x2, and outlive the query)
+	void build(const Grid<float> &heights);
+
+	// whether there are heights to query
+	bool ready() const { return !this->levels.empty(); }
+
+	// whether (x, z) is over the grid
+	bool contains(float x, float z) const;
+
+	// the height of the ground at (x, z), clamped to the edge of the grid outside it
+	float height(float x, float z) const;
+
+	// the heights at count points (x[i], z[i]) into out, the same as calling height() on each
+	void heights(const float *x, const float *z, int count, float *out) const;
+
+	// finds the first point along origin + t * direction, for t from 0 to maxT, where the ray
+	// meets the ground. origin should be above the ground. returns false if it misses, or
+	// leaves the grid first
+	bool intersect(const Vec3D &origin, const Vec3D &direction, float maxT, RayHit &hit) const;
+
+	// quadtree nodes the last intersect() looked inside
+	mutable int nodesVisited;
+
+private:
+	// the query owns its levels, so it can't be copied
+	HeightQuery(const HeightQuery &other);
+	HeightQuery &operator=(const HeightQuery &other);
+
+	// the lowest and highest point under a node
+	struct HeightRange {
+		float min;
+		float max;
+	};
+
+	// finds the first t in [t0, t1] where the ray meets the bilinear surface of cell (cx, cz)
+	bool hitCell(int cx, int cz, const double origin[3], const double direction[3], double t0, double t1, double &t) const;
+
+	void release();
+
+	const Grid<float> *grid;
+	// level 0 has a range per cell, each level above a range per 2x2 of the one below,
+	// up to a single node for the whole grid
+	std::vector<Grid<HeightRange>*> levels;
+};
+
+#endif
@@ -0,0 +1,409 @@
+#include "heightmapFile.h"
+#include "normalKernel.h"
+#include "parallelFor.h"
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+
+const char MAGIC[4] = {'T', 'H', 'C', '1'};
+const unsigned int VERSION = 1;
+const unsigned int FLAG_NORMALS = 1;
+
+// the header is this many 32-bit little endian words, followed by the byte size of each stripe
+const int HEADER_WORDS = 14;
+
+// quantised values are 16 bits, so a residual needs 17
+const int RESIDUAL_BITS = 17;
+// a residual with this many bits of quotient or more is written out raw instead
+const int ESCAPE = 24;
+
+void putWord(std::vector<unsigned char> &out, unsigned int word) {
+	for (int i = 0; i < 4; i++) out.push_back((word >> (8 * i)) & 0xff);
+}
+
+unsigned int getWord(const unsigned char *in) {
+	return in[0] | (in[1] << 8) | (in[2] << 16) | ((unsigned int)in[3] << 24);
+}
+
+unsigned int floatBits(float value) {
+	unsigned int bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+float bitsFloat(unsigned int bits) {
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+inline int trailingZeros(unsigned long long value) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, value);
+	return index;
+#else
+	return __builtin_ctzll(value);
+#endif
+}
+
+/**
+* Appends bits to a byte array, least significant bit first.
+*/
+class BitWriter {
+public:
+	BitWriter(std::vector<unsigned char> &out) : out(out), bits(0), count(0) {}
+
+	// appends the low n bits of value, n is at most 32
+	void put(unsigned int value, int n) {
+		this->bits |= (unsigned long long)value << this->count;
+		this->count += n;
+		while (this->count >= 8) {
+			this->out.push_back(this->bits & 0xff);
+			this->bits >>= 8;
+			this->count -= 8;
+		}
+	}
+
+	// quotient in unary (as zeros ended by a one) then the remainder in k bits
+	void putRice(unsigned int value, int k) {
+		unsigned int quotient = value >> k;
+		if (quotient >= (unsigned int)ESCAPE) {
+			this->put(0, ESCAPE);
+			this->put(value, RESIDUAL_BITS);
+			return;
+		}
+		this->put(1u << quotient, quotient + 1);
+		this->put(value & ((1u << k) - 1), k);
+	}
+
+	// writes out the last partial byte
+	void flush() {
+		if (this->count > 0) this->out.push_back(this->bits & 0xff);
+		this->bits = 0;
+		this->count = 0;
+	}
+
+private:
+	std::vector<unsigned char> &out;
+	unsigned long long bits;
+	int count;
+};
+
+/**
+* Reads back what a BitWriter wrote. Reading past the end gives zeros.
+*/
+class BitReader {
+public:
+	BitReader(const unsigned char *data, size_t size) : data(data), end(data + size), bits(0), count(0) {}
+
+	unsigned int get(int n) {
+		this->refill();
+		return this->take(n);
+	}
+
+	unsigned int getRice(int k) {
+		// there's always room for the unary part and the remainder after a refill
+		this->refill();
+		int zeros = this->bits ? trailingZeros(this->bits) : 64;
+		if (zeros >= ESCAPE) {
+			this->take(ESCAPE);
+			return this->take(RESIDUAL_BITS);
+		}
+		this->take(zeros + 1);
+		return ((unsigned int)zeros << k) | this->take(k);
+	}
+
+private:
+	// makes sure there are at least 57 bits buffered
+	void refill() {
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+		// away from the end, load 8 bytes at once and keep the whole bytes that fit
+		if (this->end - this->data >= 8) {
+			unsigned long long word;
+			memcpy(&word, this->data, sizeof(word));
+			this->bits |= word << this->count;
+			this->data += (63 - this->count) >> 3;
+			this->count |= 56;
+			return;
+		}
+#endif
+		while (this->count <= 56) {
+			unsigned long long byte = this->data < this->end ? *this->data++ : 0;
+			this->bits |= byte << this->count;
+			this->count += 8;
+		}
+	}
+
+	unsigned int take(int n) {
+		unsigned int value = (unsigned int)(this->bits & ((1ull << n) - 1));
+		this->bits >>= n;
+		this->count -= n;
+		return value;
+	}
+
+	const unsigned char *data;
+	const unsigned char *end;
+	unsigned long long bits;
+	int count;
+};
+
+// residuals are signed, Rice codes aren't: 0, -1, 1, -2, ... become 0, 1, 2, 3, ...
+inline unsigned int zigzag(int value) {
+	return value < 0 ? ((unsigned int)(-value) << 1) - 1 : (unsigned int)value << 1;
+}
+
+inline int unzigzag(unsigned int value) {
+	return (value & 1) ? -(int)((value + 1) >> 1) : (int)(value >> 1);
+}
+
+/**
+* The previous row's value, moved by how much the row changed over the last
+* step. The first row of a stripe has nothing before it, so it uses the
+* previous value in the row.
+*/
+inline int predict(const unsigned short *row, const unsigned short *previous, int z) {
+	if (!previous) return z > 0 ? row[z - 1] : 0;
+	if (z == 0) return previous[0];
+	int p = previous[z] + row[z - 1] - previous[z - 1];
+	return p < 0 ? 0 : (p > 65535 ? 65535 : p);
+}
+
+/**
+* Codes rows of a plane of 16-bit values, each row starting with its Rice parameter:
+* the smallest k where the residuals average no more than 2^k.
+*/
+void encodeRows(const unsigned short *plane, int rows, int z_size, BitWriter &out, std::vector<unsigned int> &residuals) {
+	residuals.resize(z_size);
+	for (int x = 0; x < rows; x++) {
+		const unsigned short *row = plane + (size_t)x * z_size;
+		const unsigned short *previous = x > 0 ? row - z_size : NULL;
+		unsigned long long sum = 0;
+		for (int z = 0; z < z_size; z++) {
+			residuals[z] = zigzag(row[z] - predict(row, previous, z));
+			sum += residuals[z];
+		}
+		int k = 0;
+		while (k < 16 && ((unsigned long long)z_size << k) < sum) k++;
+		out.put(k, 5);
+		for (int z = 0; z < z_size; z++) out.putRice(residuals[z], k);
+	}
+}
+
+/**
+* The same predictions as predict(), with the special cases taken out of the loop.
+*/
+void decodeRows(unsigned short *plane, int rows, int z_size, BitReader &in) {
+	for (int x = 0; x < rows; x++) {
+		unsigned short *row = plane + (size_t)x * z_size;
+		int k = std::min((int)in.get(5), 16);
+		if (x == 0) {
+			int value = 0;
+			for (int z = 0; z < z_size; z++) {
+				value = (unsigned short)(value + unzigzag(in.getRice(k)));
+				row[z] = value;
+			}
+			continue;
+		}
+		const unsigned short *previous = row - z_size;
+		row[0] = (unsigned short)(previous[0] + unzigzag(in.getRice(k)));
+		for (int z = 1; z < z_size; z++) {
+			int p = previous[z] + row[z - 1] - previous[z - 1];
+			p = p < 0 ? 0 : (p > 65535 ? 65535 : p);
+			row[z] = (unsigned short)(p + unzigzag(in.getRice(k)));
+		}
+	}
+}
+
+unsigned short quantise(float value) {
+	if (!(value > 0)) return 0;
+	if (value >= 1) return 65535;
+	return (unsigned short)(value * 65535 + 0.5f);
+}
+
+// normals always point up, so the top half of an octahedron is enough to map them onto a square
+void packNormal(const Vec3D &n, unsigned short &u, unsigned short &v) {
+	float sum = fabs(n.mX) + fabs(n.mY) + fabs(n.mZ);
+	if (sum == 0) sum = 1;
+	u = quantise(n.mX / sum * 0.5f + 0.5f);
+	v = quantise(n.mZ / sum * 0.5f + 0.5f);
+}
+
+Vec3D unpackNormal(unsigned short u, unsigned short v) {
+	float x = u / 65535.0f * 2 - 1;
+	float z = v / 65535.0f * 2 - 1;
+	float y = std::max(1 - fabsf(x) - fabsf(z), 0.0f);
+	float length = sqrtf(x*x + y*y + z*z);
+	if (length == 0) return Vec3D(0, 1, 0);
+	return Vec3D(x / length, y / length, z / length);
+}
+
+int stripeCount(int x_size) {
+	return (x_size + HEIGHTMAP_STRIPE_ROWS - 1) / HEIGHTMAP_STRIPE_ROWS;
+}
+
+}
+
+bool saveTerrain(const TerrainState &state, const char *file, bool withNormals, const char **error) {
+	if (state.x_size < 1 || state.z_size < 1) {
+		*error = "there's no terrain to save";
+		return false;
+	}
+	int x_size = state.x_size;
+	int z_size = state.z_size;
+	float scale = state.max_height > 0 ? 1 / state.max_height : 1;
+	int stripes = stripeCount(x_size);
+
+	std::vector<std::vector<unsigned char> > coded(stripes);
+	parallelFor(stripes, 0, [&](int s) {
+		int x0 = s * HEIGHTMAP_STRIPE_ROWS;
+		int rows = std::min(HEIGHTMAP_STRIPE_ROWS, x_size - x0);
+		std::vector<unsigned short> plane((size_t)rows * z_size);
+		std::vector<unsigned short> planeV;
+		std::vector<unsigned int> residuals;
+		BitWriter out(coded[s]);
+
+		for (int x = 0; x < rows; x++) {
+			const float *heights = state.heightmap.row(x0 + x);
+			unsigned short *row = &plane[(size_t)x * z_size];
+			for (int z = 0; z < z_size; z++) row[z] = quantise(heights[z] * scale);
+		}
+		encodeRows(&plane[0], rows, z_size, out, residuals);
+
+		if (withNormals) {
+			planeV.resize(plane.size());
+			for (int x = 0; x < rows; x++) {
+				const Vec3D *normals = state.normals.row(x0 + x);
+				for (int z = 0; z < z_size; z++) {
+					packNormal(normals[z], plane[(size_t)x * z_size + z], planeV[(size_t)x * z_size + z]);
+				}
+			}
+			encodeRows(&plane[0], rows, z_size, out, residuals);
+			encodeRows(&planeV[0], rows, z_size, out, residuals);
+		}
+		out.flush();
+	});
+
+	std::vector<unsigned char> header;
+	header.insert(header.end(), MAGIC, MAGIC + 4);
+	putWord(header, VERSION);
+	putWord(header, x_size);
+	putWord(header, z_size);
+	putWord(header, floatBits(state.max_height));
+	putWord(header, state.seed);
+	putWord(header, floatBits(state.params.circleSize));
+	putWord(header, floatBits(state.params.displacement));
+	// the decay is a double, so it takes two words
+	unsigned long long decay;
+	memcpy(&decay, &state.params.decay, sizeof(decay));
+	putWord(header, decay & 0xffffffff);
+	putWord(header, decay >> 32);
+	putWord(header, state.params.circles);
+	putWord(header, withNormals ? FLAG_NORMALS : 0);
+	putWord(header, HEIGHTMAP_STRIPE_ROWS);
+	putWord(header, stripes);
+	for (int s = 0; s < stripes; s++) putWord(header, coded[s].size());
+
+	FILE *out = fopen(file, "wb");
+	if (!out) {
+		*error = "could not create the file";
+		return false;
+	}
+	bool ok = fwrite(&header[0], header.size(), 1, out) == 1;
+	for (int s = 0; s < stripes && ok; s++) {
+		ok = coded[s].empty() || fwrite(&coded[s][0], coded[s].size(), 1, out) == 1;
+	}
+	if (fclose(out) != 0) ok = false;
+	if (!ok) *error = "could not write the file";
+	return ok;
+}
+
+bool loadTerrain(TerrainState &state, const char *file, const char **error) {
+	FILE *in = fopen(file, "rb");
+	if (!in) {
+		*error = "could not open the file";
+		return false;
+	}
+	fseek(in, 0, SEEK_END);
+	long size = ftell(in);
+	fseek(in, 0, SEEK_SET);
+	std::vector<unsigned char> data(size > 0 ? size : 0);
+	bool read = !data.empty() && fread(&data[0], data.size(), 1, in) == 1;
+	fclose(in);
+	if (!read) data.clear();
+
+	if (data.size() < HEADER_WORDS * 4 || memcmp(&data[0], MAGIC, 4) != 0) {
+		*error = "not a saved terrain";
+		return false;
+	}
+	const unsigned char *words = &data[0];
+	if (getWord(words + 4) != VERSION) {
+		*error = "unsupported version";
+		return false;
+	}
+	int x_size = getWord(words + 8);
+	int z_size = getWord(words + 12);
+	unsigned int flags = getWord(words + 44);
+	int stripes = getWord(words + 52);
+	if (x_size < 1 || z_size < 1 || (int)getWord(words + 48) != HEIGHTMAP_STRIPE_ROWS || stripes != stripeCount(x_size) ||
+			data.size() < (size_t)(HEADER_WORDS + stripes) * 4) {
+		*error = "invalid header";
+		return false;
+	}
+
+	// where each stripe starts
+	std::vector<size_t> offsets(stripes + 1);
+	offsets[0] = (size_t)(HEADER_WORDS + stripes) * 4;
+	for (int s = 0; s < stripes; s++) offsets[s + 1] = offsets[s] + getWord(words + (HEADER_WORDS + s) * 4);
+	if (offsets[stripes] > data.size()) {
+		*error = "file is truncated";
+		return false;
+	}
+
+	state.allocate(x_size, z_size);
+	state.max_height = bitsFloat(getWord(words + 16));
+	state.seed = getWord(words + 20);
+	state.params.circleSize = bitsFloat(getWord(words + 24));
+	state.params.displacement = bitsFloat(getWord(words + 28));
+	unsigned long long decay = getWord(words + 32) | ((unsigned long long)getWord(words + 36) << 32);
+	memcpy(&state.params.decay, &decay, sizeof(decay));
+	state.params.circles = getWord(words + 40);
+
+	float scale = state.max_height / 65535;
+	bool withNormals = (flags & FLAG_NORMALS) != 0;
+	parallelFor(stripes, 0, [&](int s) {
+		int x0 = s * HEIGHTMAP_STRIPE_ROWS;
+		int rows = std::min(HEIGHTMAP_STRIPE_ROWS, x_size - x0);
+		std::vector<unsigned short> plane((size_t)rows * z_size);
+		BitReader in(&data[offsets[s]], offsets[s + 1] - offsets[s]);
+
+		decodeRows(&plane[0], rows, z_size, in);
+		for (int x = 0; x < rows; x++) {
+			float *heights = state.heightmap.row(x0 + x);
+			const unsigned short *row = &plane[(size_t)x * z_size];
+			for (int z = 0; z < z_size; z++) heights[z] = row[z] * scale;
+		}
+
+		if (withNormals) {
+			std::vector<unsigned short> planeV(plane.size());
+			decodeRows(&plane[0], rows, z_size, in);
+			decodeRows(&planeV[0], rows, z_size, in);
+			for (int x = 0; x < rows; x++) {
+				Vec3D *normals = state.normals.row(x0 + x);
+				for (int z = 0; z < z_size; z++) {
+					normals[z] = unpackNormal(plane[(size_t)x * z_size + z], planeV[(size_t)x * z_size + z]);
+				}
+			}
+		}
+	});
+
+	if (!withNormals) computeVertexNormals(state.heightmap, state.normals);
+	return true;
+}
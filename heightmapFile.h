@@ -0,0 +1,33 @@
+#ifndef HEIGHTMAP_FILE_H
+#define HEIGHTMAP_FILE_H
+
+#include "terrainGenerator.h"
+
+/**
+* Saves and loads terrains in a compact binary format, so a terrain can be
+* got back without generating it again.
+*
+* The header records the size, max height, seed and generator settings.
+* Heights are quantised to 16 bits against max_height, and the grid is cut
+* into stripes of HEIGHTMAP_STRIPE_ROWS rows that are coded independently,
+* so they're encoded and decoded on as many threads as there are cores.
+* Within a stripe each value is predicted from the row before it (carried
+* along by the change since the previous value, so slopes predict well),
+* and the residuals of each row are Rice coded with a parameter picked for
+* that row.
+*
+* Normals can be saved too, packed into two 16-bit values each and coded
+* the same way. When they aren't, loading computes them from the heights.
+*/
+
+// rows in each independently coded stripe
+const int HEIGHTMAP_STRIPE_ROWS = 64;
+
+// writes the terrain's heights to file, and its normals if withNormals is set.
+// on failure returns false and points error at a description.
+bool saveTerrain(const TerrainState &state, const char *file, bool withNormals, const char **error);
+
+// reads a terrain written by saveTerrain into state, with currentheight left at 0
+bool loadTerrain(TerrainState &state, const char *file, const char **error);
+
+#endif
@@ -0,0 +1,217 @@
+#include "glExtensions.h"
+#include "hudText.h"
+#include <cstddef>
+
+GlyphAtlas::GlyphAtlas() {
+	this->font = NULL;
+	this->texture = 0;
+	this->lineHeight = 0;
+	this->descent = 0;
+	this->padding = 2;
+}
+
+GlyphAtlas::~GlyphAtlas() {
+	this->release();
+}
+
+/**
+* Frees the texture. Needs the context to still be current.
+*/
+void GlyphAtlas::release() {
+	if (this->texture) glDeleteTextures(1, &this->texture);
+	this->texture = 0;
+}
+
+const GlyphAtlas::Glyph *GlyphAtlas::glyph(unsigned char c) const {
+	if (c < FIRST_CHAR || c > LAST_CHAR) return NULL;
+	return &this->glyphs[c - FIRST_CHAR];
+}
+
+/**
+* GLUT only knows how to draw its fonts with glBitmap, so the characters are
+* drawn into the bottom left of the back buffer in white, one per cell, and
+* read back as the alpha of the texture.
+*/
+bool GlyphAtlas::build(void *font) {
+	this->release();
+	this->font = font;
+	this->lineHeight = glutBitmapHeight(font);
+	// GLUT doesn't say how far characters hang below the baseline, a quarter of the line is plenty
+	this->descent = this->lineHeight / 4 + this->padding;
+	int cellHeight = this->lineHeight + 2 * this->padding;
+
+	// pack the cells into rows of a 256 pixel wide texture
+	const int width = 256;
+	int x = 0, y = 0;
+	for (int c = FIRST_CHAR; c <= LAST_CHAR; c++) {
+		Glyph &g = this->glyphs[c - FIRST_CHAR];
+		g.advance = glutBitmapWidth(font, c);
+		g.width = g.advance + 2 * this->padding;
+		g.height = cellHeight;
+		if (x + g.width > width) {
+			x = 0;
+			y += cellHeight;
+		}
+		g.s0 = x;
+		g.t0 = y;
+		x += g.width;
+	}
+	int height = 1;
+	while (height < y + cellHeight) height *= 2;
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	if (viewport[2] < width || viewport[3] < height) return false;
+
+	glPushAttrib(GL_ALL_ATTRIB_BITS);
+	glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+	glDisable(GL_LIGHTING);
+	glDisable(GL_TEXTURE_2D);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	glOrtho(0, viewport[2], 0, viewport[3], -1, 1);
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+
+	glClearColor(0, 0, 0, 1);
+	glClear(GL_COLOR_BUFFER_BIT);
+	glColor3f(1, 1, 1);
+	for (int c = FIRST_CHAR; c <= LAST_CHAR; c++) {
+		Glyph &g = this->glyphs[c - FIRST_CHAR];
+		glRasterPos2i(g.s0 + this->padding, g.t0 + this->descent);
+		glutBitmapCharacter(font, c);
+	}
+
+	std::vector<unsigned char> pixels((size_t)width * height);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(viewport[0], viewport[1], width, height, GL_RED, GL_UNSIGNED_BYTE, &pixels[0]);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	glGenTextures(1, &this->texture);
+	glBindTexture(GL_TEXTURE_2D, this->texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, width, height, 0, GL_ALPHA, GL_UNSIGNED_BYTE, &pixels[0]);
+	// texels line up with pixels, so there's nothing to filter
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glPopMatrix();
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	glPopClientAttrib();
+	glPopAttrib();
+
+	// texture coordinates of the cells
+	for (int c = FIRST_CHAR; c <= LAST_CHAR; c++) {
+		Glyph &g = this->glyphs[c - FIRST_CHAR];
+		g.s1 = (g.s0 + g.width) / width;
+		g.t1 = (g.t0 + g.height) / height;
+		g.s0 /= width;
+		g.t0 /= height;
+	}
+	return true;
+}
+
+HudText::HudText(GlyphAtlas &atlas) : atlas(atlas) {
+	this->dirty = true;
+}
+
+void HudText::setText(const std::string &text) {
+	if (text == this->mText) return;
+	this->mText = text;
+	this->dirty = true;
+}
+
+/**
+* One quad per character, with the pen starting at (0, 0) and moving down a
+* line at each newline. Characters that aren't in the atlas are skipped.
+*/
+void HudText::rebuild() {
+	this->vertices.clear();
+	int penX = 0, penY = 0;
+	for (size_t i = 0; i < this->mText.size(); i++) {
+		unsigned char c = this->mText[i];
+		if (c == '\n') {
+			penX = 0;
+			penY -= this->atlas.lineHeight;
+			continue;
+		}
+		const GlyphAtlas::Glyph *g = this->atlas.glyph(c);
+		if (!g) continue;
+
+		float x0 = penX - this->atlas.padding;
+		float y0 = penY - this->atlas.descent;
+		float x1 = x0 + g->width;
+		float y1 = y0 + g->height;
+		float quad[16] = {
+			x0, y0, g->s0, g->t0,
+			x1, y0, g->s1, g->t0,
+			x1, y1, g->s1, g->t1,
+			x0, y1, g->s0, g->t1,
+		};
+		this->vertices.insert(this->vertices.end(), quad, quad + 16);
+		penX += g->advance;
+	}
+	this->dirty = false;
+}
+
+/**
+* Draws the text in pixel coordinates, leaving the matrices and state as they were.
+*/
+void HudText::draw(int x, int y) {
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	glOrtho(0, viewport[2], 0, viewport[3], -1, 1);
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+
+	if (!this->atlas.ready()) {
+		// no atlas, so draw it the slow way
+		glRasterPos2i(x, y);
+		glutBitmapString(this->atlas.font, reinterpret_cast<const unsigned char*>(this->mText.c_str()));
+	} else {
+		if (this->dirty) this->rebuild();
+		glTranslatef(x, y, 0);
+
+		glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT | GL_COLOR_BUFFER_BIT | GL_POLYGON_BIT);
+		glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+		glDisable(GL_LIGHTING);
+		glDisable(GL_DEPTH_TEST);
+		glDisable(GL_CULL_FACE);
+		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glEnable(GL_TEXTURE_2D);
+		glBindTexture(GL_TEXTURE_2D, this->atlas.texture);
+		// the color comes from glColor, the texture only says which pixels are covered
+		glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+
+		if (!this->vertices.empty()) {
+			glEnableClientState(GL_VERTEX_ARRAY);
+			glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+			glDisableClientState(GL_NORMAL_ARRAY);
+			glDisableClientState(GL_COLOR_ARRAY);
+			glVertexPointer(2, GL_FLOAT, 4 * sizeof(float), &this->vertices[0]);
+			glTexCoordPointer(2, GL_FLOAT, 4 * sizeof(float), &this->vertices[2]);
+			glDrawArrays(GL_QUADS, 0, this->vertices.size() / 4);
+		}
+
+		glPopClientAttrib();
+		glPopAttrib();
+	}
+
+	glPopMatrix();
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+}
@@ -0,0 +1,90 @@
+#ifndef HUD_TEXT_H
+#define HUD_TEXT_H
+
+#include "glExtensions.h"
+#include <string>
+#include <vector>
+
+/**
+* A GLUT bitmap font rasterized once into a texture.
+* Each printable ASCII character gets a cell in the atlas, so a whole block
+* of text can be drawn as textured quads instead of one glBitmap per character.
+*/
+class GlyphAtlas {
+public:
+	GlyphAtlas();
+	~GlyphAtlas();
+
+	// rasterizes font into the atlas. this draws into (and clears) the back buffer,
+	// so call it before drawing a frame. returns false if the font doesn't fit.
+	bool build(void *font);
+
+	// whether build() has succeeded
+	bool ready() const { return this->texture != 0; }
+
+	// frees the texture
+	void release();
+
+	// the first and last characters in the atlas
+	static const int FIRST_CHAR = 32;
+	static const int LAST_CHAR = 126;
+
+	struct Glyph {
+		// how far the pen moves after this character
+		int advance;
+		// size of the cell in pixels, and where it is in the atlas
+		int width;
+		int height;
+		float s0, t0, s1, t1;
+	};
+
+	// the glyph for c, or NULL if it isn't in the atlas
+	const Glyph *glyph(unsigned char c) const;
+
+	void *font;
+	GLuint texture;
+	// distance between lines, like glutBitmapString uses
+	int lineHeight;
+	// how far below the baseline (and left of the pen) each cell starts
+	int descent;
+	int padding;
+
+private:
+	// the atlas owns a GL texture, so it can't be copied
+	GlyphAtlas(const GlyphAtlas &other);
+	GlyphAtlas &operator=(const GlyphAtlas &other);
+
+	Glyph glyphs[LAST_CHAR - FIRST_CHAR + 1];
+};
+
+/**
+* A block of text drawn from a glyph atlas in one draw call.
+* The quads are only rebuilt when the text actually changes, so drawing the
+* same text every frame costs the same however many lines there are.
+* Falls back to glutBitmapString if the atlas couldn't be built.
+*/
+class HudText {
+public:
+	HudText(GlyphAtlas &atlas);
+
+	// sets the text, newlines start a new line. does nothing if it's the same as before.
+	void setText(const std::string &text);
+
+	const std::string &text() const { return this->mText; }
+
+	// draws the text with the baseline of the first line at window pixel (x, y), in the current color
+	void draw(int x, int y);
+
+private:
+	// lays out the quads for the text
+	void rebuild();
+
+	GlyphAtlas &atlas;
+	std::string mText;
+	bool dirty;
+
+	// two floats of position then two of texture coordinate per vertex, four vertices per character
+	std::vector<float> vertices;
+};
+
+#endif
@@ -1,5 +1,6 @@
 #include <math.h>
 #include "mathLib3D.h"
+#include "vecMath.h"
 
 Point3D::Point3D() : Point3D(0.0, 0.0, 0.0) {}
 
@@ -10,11 +11,11 @@ Point3D::Point3D(float inX, float inY, float inZ) {
 }
 
 float Point3D::distanceTo(Point3D other) {
-	return sqrt(pow(other.mX - mX, 2) + pow(other.mY - mY, 2) + pow(other.mZ - mZ, 2));
+	return sqrtf(fastDistanceTo(other));
 }
 
 float Point3D::fastDistanceTo(Point3D other) {
-	return pow(other.mX - mX, 2) + pow(other.mY - mY, 2) + pow(other.mZ - mZ, 2);
+	return lengthSquared3(other.mX - mX, other.mY - mY, other.mZ - mZ);
 }
 
 Vec3D::Vec3D() : Vec3D(0.0, 0.0, 0.0) {}
@@ -26,11 +27,12 @@ Vec3D::Vec3D(float inX, float inY, float inZ) {
 }
 
 float Vec3D::length() {
-	return sqrt(pow(mX, 2) + pow(mY, 2) + pow(mZ, 2));
+	return sqrtf(lengthSquared3(mX, mY, mZ));
 }
 
 Vec3D Vec3D::normalize() {
-	return Vec3D(mX/length(), mY/length(), mZ/length());
+	float inv = 1.0f / length();
+	return Vec3D(mX*inv, mY*inv, mZ*inv);
 }
 
 Vec3D Vec3D::multiply(float scalar) {
@@ -75,21 +77,21 @@ void RotationMatrix::setAngle(float new_angle) {
 // this is all taken from wikipedia for rotation matrix,
 // https://en.wikipedia.org/wiki/Rotation_matrix
 void RotationMatrix::update() {
-	float ang = (angle * 3.14) / 180;
+	float ang = degreesToRadians(angle);
 	float c_ang = cos(ang);
 	float s_ang = sin(ang);
 
-	matrix[0][0] = c_ang + (pow(axis.mX, 2) * (1 - c_ang));
+	matrix[0][0] = c_ang + (square(axis.mX) * (1 - c_ang));
 	matrix[0][1] = (axis.mX * axis.mY * (1 - c_ang)) - (axis.mZ * s_ang);
 	matrix[0][2] = (axis.mX * axis.mZ * (1 - c_ang)) + (axis.mY * s_ang);
 
 	matrix[1][0] = (axis.mY * axis.mX * (1 - c_ang)) + (axis.mZ * s_ang);
-	matrix[1][1] = c_ang + (pow(axis.mY, 2) * (1 - c_ang));
+	matrix[1][1] = c_ang + (square(axis.mY) * (1 - c_ang));
 	matrix[1][2] = (axis.mY * axis.mZ * (1 - c_ang)) - (axis.mX * s_ang);
 
 	matrix[2][0] = (axis.mZ * axis.mX * (1 - c_ang)) - (axis.mY * s_ang);
 	matrix[2][1] = (axis.mZ * axis.mY * (1 - c_ang)) + (axis.mX * s_ang);
-	matrix[2][2] = c_ang + (pow(axis.mZ, 2) * (1 - c_ang));
+	matrix[2][2] = c_ang + (square(axis.mZ) * (1 - c_ang));
 }
 
 // multiply a vector by this rotation matrix
@@ -0,0 +1,167 @@
+#include "glExtensions.h"
+#include "minimap.h"
+#include <algorithm>
+
+Minimap::Minimap() {
+	this->uploadedTexels = 0;
+	this->texture = 0;
+	this->width = 0;
+	this->height = 0;
+	this->textureWidth = 0;
+	this->textureHeight = 0;
+	this->level = -1;
+	this->max_height = 0;
+}
+
+Minimap::~Minimap() {
+	this->release();
+}
+
+/**
+* Frees the texture. Needs the context to still be current.
+*/
+void Minimap::release() {
+	if (this->texture) glDeleteTextures(1, &this->texture);
+	this->texture = 0;
+	this->width = 0;
+	this->height = 0;
+	this->level = -1;
+	this->pyramid.release();
+}
+
+// smallest power of two that's at least n, GL 1.5 doesn't have to support other texture sizes
+static int powerOfTwo(int n) {
+	int p = 1;
+	while (p < n) p *= 2;
+	return p;
+}
+
+void Minimap::update(const TerrainState &terrain, const ColorRamp &ramp, int max_width, int max_height) {
+	this->update(terrain, ramp, max_width, max_height, 0, 0, terrain.x_size, terrain.z_size);
+}
+
+void Minimap::update(const TerrainState &terrain, const ColorRamp &ramp, int max_width, int max_height,
+		int x0, int z0, int x1, int z1) {
+	this->update(terrain.currentheight, terrain.max_height, ramp, max_width, max_height, x0, z0, x1, z1);
+}
+
+/**
+* Updates the pyramid over the changed region, then recolors the texels
+* above it and uploads the rectangle around the ones that changed.
+*/
+void Minimap::update(const Grid<float> &heights, float terrain_max_height, const ColorRamp &ramp,
+		int max_width, int max_height, int x0, int z0, int x1, int z1) {
+	this->uploadedTexels = 0;
+	if (heights.x_size <= 0 || heights.z_size <= 0) return;
+
+	bool rebuild = this->pyramid.levelCount() == 0 ||
+		this->pyramid.level(0).x_size != heights.x_size || this->pyramid.level(0).z_size != heights.z_size;
+	if (rebuild) {
+		this->pyramid.build(heights);
+	} else {
+		this->pyramid.update(heights, x0, z0, x1, z1);
+	}
+
+	int level = this->pyramid.levelFitting(std::max(max_width, 1), std::max(max_height, 1));
+	const Grid<float> &source = this->pyramid.level(level);
+
+	// a different level (or a new terrain) means a differently sized image, so start over
+	bool resized = !this->texture || level != this->level ||
+		source.x_size != this->width || source.z_size != this->height;
+	if (resized) {
+		if (!this->texture) glGenTextures(1, &this->texture);
+		this->level = level;
+		this->width = source.x_size;
+		this->height = source.z_size;
+		this->textureWidth = powerOfTwo(this->width);
+		this->textureHeight = powerOfTwo(this->height);
+		this->pixels.assign((size_t)this->width * this->height * 4, 0);
+
+		glPushAttrib(GL_TEXTURE_BIT);
+		glBindTexture(GL_TEXTURE_2D, this->texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, this->textureWidth, this->textureHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glPopAttrib();
+	}
+
+	// every color depends on the max height, so if that moved every texel has to be redone
+	if (resized || terrain_max_height != this->max_height) {
+		x0 = 0;
+		z0 = 0;
+		x1 = heights.x_size;
+		z1 = heights.z_size;
+		this->max_height = terrain_max_height;
+	}
+
+	// the texels covering the changed heights
+	int tx0 = std::max(x0, 0) >> level;
+	int tz0 = std::max(z0, 0) >> level;
+	int tx1 = std::min(((std::min(x1, heights.x_size) - 1) >> level) + 1, this->width);
+	int tz1 = std::min(((std::min(z1, heights.z_size) - 1) >> level) + 1, this->height);
+
+	// recolor them, keeping track of the rectangle that actually changed
+	int dx0 = this->width, dz0 = this->height, dx1 = -1, dz1 = -1;
+	for (int x = tx0; x < tx1; x++) {
+		const float *row = source.row(x);
+		for (int z = tz0; z < tz1; z++) {
+			const unsigned char *color = ramp.lookup(row[z], terrain_max_height);
+			unsigned char *texel = &this->pixels[((size_t)z * this->width + x) * 4];
+			if (!resized && texel[0] == color[0] && texel[1] == color[1] && texel[2] == color[2]) continue;
+			texel[0] = color[0];
+			texel[1] = color[1];
+			texel[2] = color[2];
+			texel[3] = 255;
+			dx0 = std::min(dx0, x);
+			dx1 = std::max(dx1, x);
+			dz0 = std::min(dz0, z);
+			dz1 = std::max(dz1, z);
+		}
+	}
+	if (dx1 < 0) return;
+
+	int w = dx1 - dx0 + 1;
+	int h = dz1 - dz0 + 1;
+	// the terrain's texture stays bound
+	glPushAttrib(GL_TEXTURE_BIT);
+	glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+	glBindTexture(GL_TEXTURE_2D, this->texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, this->width);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, dx0, dz0, w, h, GL_RGBA, GL_UNSIGNED_BYTE,
+		&this->pixels[((size_t)dz0 * this->width + dx0) * 4]);
+	glPopClientAttrib();
+	glPopAttrib();
+	this->uploadedTexels = w * h;
+}
+
+/**
+* Draws the minimap as one quad. The caller's texturing and lighting state is left alone.
+*/
+void Minimap::draw(float left, float bottom, float right, float top, float alpha) {
+	if (!this->texture) return;
+
+	float s = (float)this->width / this->textureWidth;
+	float t = (float)this->height / this->textureHeight;
+
+	glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT | GL_CURRENT_BIT | GL_COLOR_BUFFER_BIT | GL_POLYGON_BIT);
+	// it's an overlay, so it shouldn't be hidden by whatever is behind it in the depth buffer
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_LIGHTING);
+	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	glEnable(GL_TEXTURE_2D);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glBindTexture(GL_TEXTURE_2D, this->texture);
+	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+	glColor4f(1.0, 1.0, 1.0, alpha);
+	glBegin(GL_QUADS);
+		glTexCoord2f(0, 0); glVertex2f(left, bottom);
+		glTexCoord2f(s, 0); glVertex2f(right, bottom);
+		glTexCoord2f(s, t); glVertex2f(right, top);
+		glTexCoord2f(0, t); glVertex2f(left, top);
+	glEnd();
+	glPopAttrib();
+}
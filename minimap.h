@@ -0,0 +1,66 @@
+#ifndef MINIMAP_H
+#define MINIMAP_H
+
+#include "glExtensions.h"
+#include "terrainGenerator.h"
+#include "colorRamp.h"
+#include "heightPyramid.h"
+#include <vector>
+
+/**
+* The terrain overview on the HUD, drawn as a single textured quad.
+*
+* The texture is never bigger than the minimap is on screen: it's colored
+* from the level of a max-height pyramid that fits, so each texel shows the
+* highest point of the area it covers. When the terrain changes only the
+* texels whose color actually changed are re-uploaded.
+*/
+class Minimap {
+public:
+	Minimap();
+	~Minimap();
+
+	// brings the texture up to date with the terrain's current heights.
+	// max_width and max_height are the size of the minimap on screen, in pixels.
+	void update(const TerrainState &terrain, const ColorRamp &ramp, int max_width, int max_height);
+
+	// same, but only the heights in rows [x0, x1) and columns [z0, z1) changed since the last update
+	void update(const TerrainState &terrain, const ColorRamp &ramp, int max_width, int max_height,
+		int x0, int z0, int x1, int z1);
+
+	// the same for any grid of heights up to terrain_max_height, such as an overview of a terrain too big to keep in memory
+	void update(const Grid<float> &heights, float terrain_max_height, const ColorRamp &ramp, int max_width, int max_height,
+		int x0, int z0, int x1, int z1);
+
+	// draws the texture over the square from (left, bottom) to (right, top), with x across and z up
+	void draw(float left, float bottom, float right, float top, float alpha);
+
+	// frees the texture
+	void release();
+
+	// number of texels uploaded by the last update, for seeing how much changed
+	int uploadedTexels;
+
+private:
+	// the minimap owns a GL texture, so it can't be copied
+	Minimap(const Minimap &other);
+	Minimap &operator=(const Minimap &other);
+
+	HeightPyramid pyramid;
+
+	GLuint texture;
+	// size of the image (one texel per cell of the pyramid level) and of the
+	// power of two texture it sits in the corner of
+	int width;
+	int height;
+	int textureWidth;
+	int textureHeight;
+	// the level and max height the texels were last colored with
+	int level;
+	float max_height;
+
+	// CPU side copy of the texels, row t of the texture is z
+	std::vector<unsigned char> pixels;
+};
+
+#endif
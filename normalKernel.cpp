@@ -0,0 +1,148 @@
+#include "normalKernel.h"
+#include "vecMath.h"
+#include <cmath>
+
+
+// adds the normalized face normal (fx, 1, fz) to the running sum
+static inline void addFace(float fx, float fz, float &sx, float &sy, float &sz) {
+	float r = 1.0f / sqrtf(fx*fx + fz*fz + 1.0f);
+	sx += fx * r;
+	sy += r;
+	sz += fz * r;
+}
+
+/**
+* Normal of a single vertex, only using the faces that exist around it.
+* Used for the border, and for everything in the scalar kernel.
+*/
+static inline void normalAt(const Grid<float> &heights, int i, int j, Vec3D &out) {
+	float h = heights(i, j);
+	bool hasRight = i+1 < heights.x_size;
+	bool hasLeft = i-1 >= 0;
+	bool hasUp = j+1 < heights.z_size;
+	bool hasDown = j-1 >= 0;
+
+	// face normals are (-dx, 1, -dz), so keep the differences in that form
+	float right = hasRight ? h - heights(i+1, j) : 0;
+	float left = hasLeft ? heights(i-1, j) - h : 0;
+	float up = hasUp ? h - heights(i, j+1) : 0;
+	float down = hasDown ? heights(i, j-1) - h : 0;
+
+	float sx = 0, sy = 0, sz = 0;
+	if (hasUp && hasRight) addFace(right, up, sx, sy, sz);
+	if (hasRight && hasDown) addFace(right, down, sx, sy, sz);
+	if (hasDown && hasLeft) addFace(left, down, sx, sy, sz);
+	if (hasLeft && hasUp) addFace(left, up, sx, sy, sz);
+
+	// a grid one vertex wide has no faces at all
+	if (sy == 0) {
+		out = Vec3D(0, 1, 0);
+		return;
+	}
+	float r = 1.0f / sqrtf(sx*sx + sy*sy + sz*sz);
+	out = Vec3D(sx * r, sy * r, sz * r);
+}
+
+// scalar normals for the vertices in [j0, j1) of row i
+static void normalRowScalar(const Grid<float> &heights, Grid<Vec3D> &normals, int i, int j0, int j1) {
+	Vec3D *out = normals.row(i);
+	for (int j = j0; j < j1; j++) {
+		normalAt(heights, i, j, out[j]);
+	}
+}
+
+// writes lanes of x/y/z components out as Vec3Ds
+static inline void storeNormals(Vec3D *out, const float *nx, const float *ny, const float *nz, int count) {
+	for (int k = 0; k < count; k++) {
+		out[k].mX = nx[k];
+		out[k].mY = ny[k];
+		out[k].mZ = nz[k];
+	}
+}
+
+#if defined(VEC_MATH_AVX) || defined(VEC_MATH_SSE)
+// VEC_LANES interior normals starting at c, with l/r the same columns of the neighbouring rows
+static inline void normalLanes(const float *c, const float *l, const float *r, Vec3D *out) {
+	const Lanes one = lanesSet(1.0f);
+	Lanes h = lanesLoad(c);
+	Lanes right = lanesSub(h, lanesLoad(r));
+	Lanes left = lanesSub(lanesLoad(l), h);
+	Lanes up = lanesSub(h, lanesLoad(c + 1));
+	Lanes down = lanesSub(lanesLoad(c - 1), h);
+
+	Lanes rr = lanesMul(right, right);
+	Lanes ll = lanesMul(left, left);
+	Lanes uu = lanesAdd(lanesMul(up, up), one);
+	Lanes dd = lanesAdd(lanesMul(down, down), one);
+
+	// inverse lengths of the four faces
+	Lanes ur = lanesInvSqrt(lanesAdd(rr, uu));
+	Lanes rd = lanesInvSqrt(lanesAdd(rr, dd));
+	Lanes dl = lanesInvSqrt(lanesAdd(ll, dd));
+	Lanes lu = lanesInvSqrt(lanesAdd(ll, uu));
+
+	// sum of the normalized faces
+	Lanes sx = lanesAdd(lanesMul(right, lanesAdd(ur, rd)), lanesMul(left, lanesAdd(dl, lu)));
+	Lanes sy = lanesAdd(lanesAdd(ur, rd), lanesAdd(dl, lu));
+	Lanes sz = lanesAdd(lanesMul(up, lanesAdd(ur, lu)), lanesMul(down, lanesAdd(rd, dl)));
+	normalizeLanes(sx, sy, sz);
+
+	float nx[VEC_LANES], ny[VEC_LANES], nz[VEC_LANES];
+	lanesStore(nx, sx);
+	lanesStore(ny, sy);
+	lanesStore(nz, sz);
+	storeNormals(out, nx, ny, nz, VEC_LANES);
+}
+#endif
+
+/**
+* Computes all of the vertex normals, two sets of lanes of interior vertices
+* per iteration.
+*/
+void computeVertexNormals(const Grid<float> &heights, Grid<Vec3D> &normals) {
+#if defined(VEC_MATH_AVX) || defined(VEC_MATH_SSE)
+	int x_size = heights.x_size;
+	int z_size = heights.z_size;
+	normals.resize(x_size, z_size);
+
+	for (int i = 0; i < x_size; i++) {
+		// the first and last rows have missing neighbours everywhere
+		if (i == 0 || i == x_size-1) {
+			normalRowScalar(heights, normals, i, 0, z_size);
+			continue;
+		}
+
+		const float *c = heights.row(i);
+		const float *l = heights.row(i-1);
+		const float *r = heights.row(i+1);
+		Vec3D *out = normals.row(i);
+
+		// the first and last column of the row are border vertices
+		normalRowScalar(heights, normals, i, 0, 1);
+		int j = 1;
+		for (; j + 2*VEC_LANES <= z_size - 1; j += 2*VEC_LANES) {
+			normalLanes(c + j, l + j, r + j, out + j);
+			normalLanes(c + j + VEC_LANES, l + j + VEC_LANES, r + j + VEC_LANES, out + j + VEC_LANES);
+		}
+		// one more set of lanes if there's room
+		if (j + VEC_LANES <= z_size - 1) {
+			normalLanes(c + j, l + j, r + j, out + j);
+			j += VEC_LANES;
+		}
+		normalRowScalar(heights, normals, i, j < z_size ? j : z_size, z_size);
+	}
+#else
+	computeVertexNormalsScalar(heights, normals);
+#endif
+}
+
+void computeVertexNormalsScalar(const Grid<float> &heights, Grid<Vec3D> &normals) {
+	normals.resize(heights.x_size, heights.z_size);
+	for (int i = 0; i < heights.x_size; i++) {
+		normalRowScalar(heights, normals, i, 0, heights.z_size);
+	}
+}
+
+const char *normalKernelName() {
+	return vecMathName();
+}
@@ -0,0 +1,29 @@
+#ifndef NORMAL_KERNEL_H
+#define NORMAL_KERNEL_H
+
+#include "mathLib3D.h"
+#include "grid.h"
+
+/**
+* Computes the vertex normals of a heightmap.
+*
+* Each normal is the normalized average of the (normalized) normals of the
+* four faces around the vertex, which is what the original cross product
+* pass computed. Expanding those cross products, every face normal is
+* (-dx, 1, -dz) for the differences along its two grid edges, so the normals
+* come straight from differences on the height grid with no Vec3D temporaries.
+*
+* Interior vertices are done 2*VEC_LANES at a time (8 with SSE, 16 with AVX)
+* with the lanes of vecMath.h, normalized in registers with normalizeLanes,
+* falling back to plain scalar code without SIMD; the border is always scalar.
+* Border vertices only average the faces that exist.
+*/
+void computeVertexNormals(const Grid<float> &heights, Grid<Vec3D> &normals);
+
+// the same computation, without any SIMD
+void computeVertexNormalsScalar(const Grid<float> &heights, Grid<Vec3D> &normals);
+
+// name of the instruction set computeVertexNormals was built with
+const char *normalKernelName();
+
+#endif
@@ -0,0 +1,96 @@
+#include "offscreenContext.h"
+#if !defined(_WIN32) && !defined(__APPLE__)
+#define OFFSCREEN_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+OffscreenContext::OffscreenContext() {
+	this->width = 0;
+	this->height = 0;
+	this->display = NULL;
+	this->context = NULL;
+	this->framebuffer = 0;
+	this->renderbuffers[0] = this->renderbuffers[1] = 0;
+}
+
+OffscreenContext::~OffscreenContext() {
+#ifdef OFFSCREEN_EGL
+	if (!this->context) return;
+	glDeleteFramebuffers(1, &this->framebuffer);
+	glDeleteRenderbuffers(2, this->renderbuffers);
+	eglMakeCurrent(this->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(this->display, this->context);
+	eglTerminate(this->display);
+#endif
+}
+
+/**
+* The context is made current with no surface at all (EGL_KHR_surfaceless_context),
+* everything is drawn into the framebuffer object instead.
+*/
+bool OffscreenContext::create(int width, int height, const char **error) {
+#ifdef OFFSCREEN_EGL
+	EGLDisplay display = EGL_NO_DISPLAY;
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay) display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	if (display == EGL_NO_DISPLAY) display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+		if (error) *error = "no EGL display";
+		return false;
+	}
+	if (!eglBindAPI(EGL_OPENGL_API)) {
+		eglTerminate(display);
+		if (error) *error = "EGL can't create desktop GL contexts";
+		return false;
+	}
+
+	EGLint attributes[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+	EGLConfig config;
+	EGLint configs = 0;
+	if (!eglChooseConfig(display, attributes, &config, 1, &configs) || configs < 1) {
+		// the surfaceless platform can get by without one
+		config = (EGLConfig)0;
+	}
+	EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, NULL);
+	if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+		if (context != EGL_NO_CONTEXT) eglDestroyContext(display, context);
+		eglTerminate(display);
+		if (error) *error = "could not create a surfaceless GL context";
+		return false;
+	}
+	this->display = display;
+	this->context = context;
+
+	// color and depth, like the window's
+	glGenFramebuffers(1, &this->framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer);
+	glGenRenderbuffers(2, this->renderbuffers);
+	glBindRenderbuffer(GL_RENDERBUFFER, this->renderbuffers[0]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, this->renderbuffers[0]);
+	glBindRenderbuffer(GL_RENDERBUFFER, this->renderbuffers[1]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, this->renderbuffers[1]);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		if (error) *error = "the framebuffer is incomplete";
+		return false;
+	}
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	glDrawBuffer(GL_COLOR_ATTACHMENT0);
+	glViewport(0, 0, width, height);
+
+	this->width = width;
+	this->height = height;
+	return true;
+#else
+	if (error) *error = "offscreen rendering needs EGL, which is only used on Linux";
+	return false;
+#endif
+}
+
+const char *OffscreenContext::renderer() const {
+	return reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+}
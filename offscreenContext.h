@@ -0,0 +1,44 @@
+#ifndef OFFSCREEN_CONTEXT_H
+#define OFFSCREEN_CONTEXT_H
+
+#include "glExtensions.h"
+
+/**
+* A GL context with no window, drawing into a framebuffer object of its own,
+* for rendering on machines without a display.
+*
+* The context comes from EGL on Mesa's surfaceless platform (falling back to
+* the default display), so it works with the llvmpipe software rasteriser and
+* no X server. It's a compatibility context, like GLUT's, so everything that
+* draws into the window can draw into it unchanged. Only Linux has it.
+*/
+class OffscreenContext {
+public:
+	OffscreenContext();
+	~OffscreenContext();
+
+	// creates the context, makes it current and binds a width x height framebuffer
+	// with a depth buffer to draw into. returns false and points *error (if given)
+	// at a description if it can't.
+	bool create(int width, int height, const char **error = NULL);
+
+	// the GL renderer the context ended up on
+	const char *renderer() const;
+
+	int width;
+	int height;
+
+private:
+	// the context is only torn down once, so it can't be copied
+	OffscreenContext(const OffscreenContext &other);
+	OffscreenContext &operator=(const OffscreenContext &other);
+
+	// EGLDisplay and EGLContext, kept opaque so EGL's headers stay out of this one
+	void *display;
+	void *context;
+
+	GLuint framebuffer;
+	GLuint renderbuffers[2];
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef PARALLEL_FOR_H
+#define PARALLEL_FOR_H
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+
+/**
+* The number of threads to use when threads were asked for: 0 means one per core.
+*/
+inline int threadCount(int threads) {
+	if (threads > 0) return threads;
+	return std::max<int>(std::thread::hardware_concurrency(), 1);
+}
+
+/**
+* Runs work(i) for i in [0, count) on up to threads threads (0 for one per core).
+* Each thread takes the next i as it finishes the last, so uneven work still
+* keeps them all busy. Returns once every i is done.
+*/
+template <typename Work>
+void parallelFor(int count, int threads, Work work) {
+	threads = std::min(threadCount(threads), count);
+	if (threads <= 1) {
+		for (int i = 0; i < count; i++) work(i);
+		return;
+	}
+	std::atomic<int> next(0);
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; t++) {
+		workers.push_back(std::thread([&work, &next, count]() {
+			for (int i = next++; i < count; i = next++) work(i);
+		}));
+	}
+	for (size_t t = 0; t < workers.size(); t++) workers[t].join();
+}
+
+#endif
@@ -0,0 +1,270 @@
+#include "rayMarcher.h"
+#include "parallelFor.h"
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+namespace {
+
+// the terrain's material, as drawTerrain() binds it. ambient and diffuse are
+// TERRAIN_MATERIAL_AMBIENT and TERRAIN_MATERIAL_DIFFUSE of the ramp color
+const float MATERIAL_SPECULAR[3] = {0.5, 0.5, 0.0};
+const float MATERIAL_SHININESS = 100;
+
+// GL's default global ambient light
+const float GLOBAL_AMBIENT = 0.2;
+
+// how far past a cell's edge a ray is pushed to find the next one
+const double STEP_NUDGE = 1e-6;
+
+// a ray in world space, t is the distance along it
+struct Ray {
+	double ox, oy, oz;
+	double dx, dy, dz;
+};
+
+// height of the mesh at (x, z) inside cell (cx, cz), on the same two triangles GL draws:
+// (cx, cz+1), (cx+1, cz+1), (cx+1, cz) and (cx, cz+1), (cx+1, cz), (cx, cz)
+inline double meshHeight(const Grid<float> &heights, int cx, int cz, double x, double z) {
+	double u = std::min(std::max(x - cx, 0.0), 1.0);
+	double v = std::min(std::max(z - cz, 0.0), 1.0);
+	double h00 = heights(cx, cz), h10 = heights(cx + 1, cz);
+	double h01 = heights(cx, cz + 1), h11 = heights(cx + 1, cz + 1);
+	if (u + v >= 1) return h01 + (h11 - h01) * u + (h11 - h10) * (v - 1);
+	return h00 + (h10 - h00) * u + (h01 - h00) * v;
+}
+
+// how far the ray is above the mesh of cell (cx, cz) at t
+inline double clearance(const Grid<float> &heights, const Ray &ray, int cx, int cz, double t) {
+	return ray.oy + ray.dy * t - meshHeight(heights, cx, cz, ray.ox + ray.dx * t, ray.oz + ray.dz * t);
+}
+
+/**
+* Finds where the ray first meets the mesh of a single cell between t0 and t1.
+* The mesh is flat on either side of the diagonal, so the ray's height above it
+* is linear in t except where it crosses the diagonal, and a sign change
+* between those points pins down the hit. Only going down through the mesh
+* counts: GL culls its back faces, so a ray coming up from under it (from
+* under the edge of the terrain, say) goes straight through.
+*/
+bool hitCell(const Grid<float> &heights, const Ray &ray, int cx, int cz, double t0, double t1, double &hit) {
+	double points[3];
+	int count = 0;
+	points[count++] = t0;
+	// where u + v = 1
+	double along = ray.dx + ray.dz;
+	if (along != 0) {
+		double td = (cx + cz + 1 - ray.ox - ray.oz) / along;
+		if (td > t0 && td < t1) points[count++] = td;
+	}
+	points[count++] = t1;
+
+	double before = clearance(heights, ray, cx, cz, points[0]);
+	for (int i = 1; i < count; i++) {
+		double after = clearance(heights, ray, cx, cz, points[i]);
+		if (before > 0 && after <= 0) {
+			hit = points[i-1] + (points[i] - points[i-1]) * before / (before - after);
+			return true;
+		}
+		before = after;
+	}
+	return false;
+}
+
+}
+
+RayMarcher::RayMarcher() {
+	this->threads = 0;
+	this->cellsVisited = 0;
+	this->hits = 0;
+}
+
+void RayMarcher::build(const TerrainState &terrain) {
+	if (terrain.x_size < 2 || terrain.z_size < 2) {
+		this->pyramid.release();
+		return;
+	}
+	const Grid<float> &heights = terrain.heightmap;
+	this->cellMax.resize(terrain.x_size - 1, terrain.z_size - 1);
+	for (int x = 0; x < this->cellMax.x_size; x++) {
+		const float *a = heights.row(x);
+		const float *b = heights.row(x + 1);
+		float *out = this->cellMax.row(x);
+		for (int z = 0; z < this->cellMax.z_size; z++) {
+			out[z] = std::max(std::max(a[z], a[z + 1]), std::max(b[z], b[z + 1]));
+		}
+	}
+	this->pyramid.build(this->cellMax);
+}
+
+/**
+* Each pixel is lit the way GL's fixed function lights a vertex with
+* GL_COLOR_MATERIAL: the ramp color scaled by the terrain's material
+* fractions is the ambient and diffuse, each light
+* is attenuated by distance, and the specular highlight uses a viewer
+* infinitely far away along the view direction.
+*/
+void RayMarcher::render(const TerrainState &terrain, Vec3D eye, Vec3D front, float fov, float nearPlane, float farPlane,
+		const SceneLight lights[SCENE_LIGHT_COUNT], const ColorRamp &ramp, int width, int height, unsigned char *pixels) {
+	std::fill(pixels, pixels + (size_t)width * height * 3, 0);
+	this->cellsVisited = 0;
+	this->hits = 0;
+	if (this->pyramid.levelCount() == 0) return;
+
+	const Grid<float> &heights = terrain.heightmap;
+	const int top = this->pyramid.levelCount() - 1;
+	const double maxHeight = this->pyramid.level(top)(0, 0);
+	const double xEnd = terrain.x_size - 1;
+	const double zEnd = terrain.z_size - 1;
+
+	// the view's axes, as gluLookAt builds them
+	front = front.normalize();
+	Vec3D right = front.cross(Vec3D(0, 1, 0)).normalize();
+	Vec3D up = right.cross(front);
+	double halfHeight = tan(fov * M_PI / 360);
+	double halfWidth = halfHeight * width / height;
+
+	int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+	int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+	std::vector<long> tileCells(tilesX * tilesY, 0);
+	std::vector<long> tileHits(tilesX * tilesY, 0);
+
+	parallelFor(tilesX * tilesY, this->threads, [&](int tile) {
+		int px0 = (tile % tilesX) * TILE_SIZE;
+		int py0 = (tile / tilesX) * TILE_SIZE;
+		int px1 = std::min(px0 + TILE_SIZE, width);
+		int py1 = std::min(py0 + TILE_SIZE, height);
+		long cells = 0;
+		long tileHitCount = 0;
+
+		for (int py = py0; py < py1; py++) {
+			for (int px = px0; px < px1; px++) {
+				double sx = (2.0 * (px + 0.5) / width - 1) * halfWidth;
+				double sy = (1 - 2.0 * (py + 0.5) / height) * halfHeight;
+				Ray ray;
+				ray.ox = eye.mX;
+				ray.oy = eye.mY;
+				ray.oz = eye.mZ;
+				ray.dx = front.mX + right.mX * sx + up.mX * sy;
+				ray.dy = front.mY + right.mY * sx + up.mY * sy;
+				ray.dz = front.mZ + right.mZ * sx + up.mZ * sy;
+				// the ray is scaled so t is the depth along the view, which is what the clip planes cut
+				double tStart = nearPlane;
+				double tEnd = farPlane;
+
+				// clip to the box around the terrain
+				if (ray.dx != 0) {
+					double a = (0 - ray.ox) / ray.dx, b = (xEnd - ray.ox) / ray.dx;
+					tStart = std::max(tStart, std::min(a, b));
+					tEnd = std::min(tEnd, std::max(a, b));
+				} else if (ray.ox < 0 || ray.ox > xEnd) continue;
+				if (ray.dz != 0) {
+					double a = (0 - ray.oz) / ray.dz, b = (zEnd - ray.oz) / ray.dz;
+					tStart = std::max(tStart, std::min(a, b));
+					tEnd = std::min(tEnd, std::max(a, b));
+				} else if (ray.oz < 0 || ray.oz > zEnd) continue;
+				if (ray.dy < 0) tStart = std::max(tStart, (maxHeight - ray.oy) / ray.dy);
+				else if (ray.oy > maxHeight) continue;
+				if (tStart > tEnd) continue;
+
+				// down a level where the ray dips under a cell's highest point, up a level once it's past it
+				int level = top;
+				double t = tStart;
+				double hit = -1;
+				int hx = 0, hz = 0;
+				while (t < tEnd) {
+					cells++;
+					const Grid<float> &grid = this->pyramid.level(level);
+					double probe = t + STEP_NUDGE;
+					int cx = (int)floor((ray.ox + ray.dx * probe) / (1 << level));
+					int cz = (int)floor((ray.oz + ray.dz * probe) / (1 << level));
+					if (cx < 0 || cz < 0 || cx >= grid.x_size || cz >= grid.z_size) break;
+
+					// where the ray leaves the cell
+					double x0 = (double)cx * (1 << level), x1 = std::min(x0 + (1 << level), xEnd);
+					double z0 = (double)cz * (1 << level), z1 = std::min(z0 + (1 << level), zEnd);
+					double exit = tEnd;
+					if (ray.dx > 0) exit = std::min(exit, (x1 - ray.ox) / ray.dx);
+					else if (ray.dx < 0) exit = std::min(exit, (x0 - ray.ox) / ray.dx);
+					if (ray.dz > 0) exit = std::min(exit, (z1 - ray.oz) / ray.dz);
+					else if (ray.dz < 0) exit = std::min(exit, (z0 - ray.oz) / ray.dz);
+
+					double cellTop = grid(cx, cz);
+					double enterY = ray.oy + ray.dy * t;
+					double exitY = ray.oy + ray.dy * exit;
+					if (std::min(enterY, exitY) > cellTop) {
+						t = exit;
+						if (level < top) level++;
+					} else if (level > 0) {
+						// nothing in this cell is above its top, so skip straight down to it
+						if (ray.dy < 0 && enterY > cellTop) t = (cellTop - ray.oy) / ray.dy;
+						level--;
+					} else if (hitCell(heights, ray, cx, cz, t, exit, hit)) {
+						hx = cx;
+						hz = cz;
+						break;
+					} else {
+						t = exit;
+					}
+				}
+				if (hit < 0) continue;
+				tileHitCount++;
+
+				// the point, its height and normal interpolated from the cell's corners
+				double x = ray.ox + ray.dx * hit;
+				double z = ray.oz + ray.dz * hit;
+				double y = meshHeight(heights, hx, hz, x, z);
+				double u = std::min(std::max(x - hx, 0.0), 1.0);
+				double v = std::min(std::max(z - hz, 0.0), 1.0);
+				const Vec3D &n00 = terrain.normals(hx, hz), &n10 = terrain.normals(hx + 1, hz);
+				const Vec3D &n01 = terrain.normals(hx, hz + 1), &n11 = terrain.normals(hx + 1, hz + 1);
+				double w00 = (1 - u) * (1 - v), w10 = u * (1 - v), w01 = (1 - u) * v, w11 = u * v;
+				double nx = n00.mX * w00 + n10.mX * w10 + n01.mX * w01 + n11.mX * w11;
+				double ny = n00.mY * w00 + n10.mY * w10 + n01.mY * w01 + n11.mY * w11;
+				double nz = n00.mZ * w00 + n10.mZ * w10 + n01.mZ * w01 + n11.mZ * w11;
+				double length = sqrt(nx * nx + ny * ny + nz * nz);
+				if (length > 0) {
+					nx /= length;
+					ny /= length;
+					nz /= length;
+				}
+
+				const unsigned char *color = ramp.lookup(y, terrain.max_height);
+				double rgb[3];
+				for (int c = 0; c < 3; c++) rgb[c] = GLOBAL_AMBIENT * TERRAIN_MATERIAL_AMBIENT * color[c] / 255.0;
+				for (int l = 0; l < SCENE_LIGHT_COUNT; l++) {
+					const SceneLight &light = lights[l];
+					double lx = light.position[0] - x, ly = light.position[1] - y, lz = light.position[2] - z;
+					double distance = sqrt(lx * lx + ly * ly + lz * lz);
+					lx /= distance;
+					ly /= distance;
+					lz /= distance;
+					double attenuation = 1 / (SCENE_LIGHT_ATTENUATION * distance);
+					double diffuse = std::max(nx * lx + ny * ly + nz * lz, 0.0);
+					double specular = 0;
+					if (diffuse > 0) {
+						// half way between the light and the viewer, who looks along front
+						double hx2 = lx - front.mX, hy2 = ly - front.mY, hz2 = lz - front.mZ;
+						double half = sqrt(hx2 * hx2 + hy2 * hy2 + hz2 * hz2);
+						double facing = half > 0 ? std::max((nx * hx2 + ny * hy2 + nz * hz2) / half, 0.0) : 0;
+						specular = pow(facing, MATERIAL_SHININESS);
+					}
+					for (int c = 0; c < 3; c++) {
+						rgb[c] += attenuation * ((light.ambient[c] * TERRAIN_MATERIAL_AMBIENT + light.diffuse[c] * TERRAIN_MATERIAL_DIFFUSE * diffuse) * color[c] / 255.0
+							+ light.specular[c] * MATERIAL_SPECULAR[c] * specular);
+					}
+				}
+				unsigned char *out = pixels + ((size_t)py * width + px) * 3;
+				for (int c = 0; c < 3; c++) out[c] = (unsigned char)(std::min(rgb[c], 1.0) * 255 + 0.5);
+			}
+		}
+		tileCells[tile] = cells;
+		tileHits[tile] = tileHitCount;
+	});
+
+	for (size_t i = 0; i < tileCells.size(); i++) {
+		this->cellsVisited += tileCells[i];
+		this->hits += tileHits[i];
+	}
+}
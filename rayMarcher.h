@@ -0,0 +1,51 @@
+#ifndef RAY_MARCHER_H
+#define RAY_MARCHER_H
+
+#include "terrainGenerator.h"
+#include "heightPyramid.h"
+#include "colorRamp.h"
+#include "sceneLights.h"
+#include "grid.h"
+
+/**
+* Renders a terrain on the CPU, with no GL (or Camera, which needs it) at
+* all, by marching a ray per pixel over heightmap. It's meant for thumbnails and previews, and draws
+* close to what the window shows from the same camera: the same mesh (each
+* cell split along the same diagonal), colors from the same ramp, and the
+* same two lights and material, shaded per pixel from the normals.
+*
+* Rays skip empty space using a max-mip pyramid of the cells' highest
+* corners. A ray only goes down a level where it dips below the highest
+* point of the cell it's in, and back up once it's out of it, so most of
+* the terrain is passed over a few levels up. The image is split into
+* TILE_SIZE square tiles that threads take in turn.
+*/
+class RayMarcher {
+public:
+	// size of the square tiles of the image the threads take, in pixels
+	static const int TILE_SIZE = 32;
+
+	RayMarcher();
+
+	// builds the pyramid for a terrain's heightmap. has to be called again whenever it changes
+	void build(const TerrainState &terrain);
+
+	// renders the terrain seen from a camera (a Camera's camPos, camFront, fov and clip planes,
+	// with the aspect ratio of the image) into width x height RGB pixels, top row first
+	void render(const TerrainState &terrain, Vec3D eye, Vec3D front, float fov, float nearPlane, float farPlane,
+		const SceneLight lights[SCENE_LIGHT_COUNT], const ColorRamp &ramp, int width, int height, unsigned char *pixels);
+
+	// threads to render with, 0 (the default) for one per core
+	int threads;
+
+	// cells of any level the rays of the last render() stepped through, and how many rays hit the terrain
+	long cellsVisited;
+	long hits;
+
+private:
+	// the highest corner of each cell of the mesh, one fewer each way than the heights
+	Grid<float> cellMax;
+	HeightPyramid pyramid;
+};
+
+#endif
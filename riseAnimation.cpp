@@ -0,0 +1,117 @@
+#include "riseAnimation.h"
+#include <algorithm>
+
+RiseAnimation::RiseAnimation() {
+	this->tilesX = 0;
+	this->tilesZ = 0;
+	this->x_size = 0;
+	this->z_size = 0;
+	this->duration = 0;
+	this->max_height = 0;
+	this->anyDirty = false;
+}
+
+/**
+* Finds the highest point of every tile. Tiles that are flat never rise, so they start out settled.
+*/
+void RiseAnimation::start(const TerrainState &terrain, double duration) {
+	this->x_size = terrain.x_size;
+	this->z_size = terrain.z_size;
+	this->tilesX = (terrain.x_size + TILE_SIZE - 1) / TILE_SIZE;
+	this->tilesZ = (terrain.z_size + TILE_SIZE - 1) / TILE_SIZE;
+	this->duration = duration;
+	this->max_height = terrain.max_height;
+
+	this->tileMax.assign(this->tilesX * this->tilesZ, 0.0f);
+	for (int x = 0; x < terrain.x_size; x++) {
+		const float *heights = terrain.heightmap.row(x);
+		float *tiles = &this->tileMax[(x / TILE_SIZE) * this->tilesZ];
+		for (int z = 0; z < terrain.z_size; z++) {
+			float &m = tiles[z / TILE_SIZE];
+			m = std::max(m, heights[z]);
+		}
+	}
+
+	this->active.clear();
+	for (int i = 0; i < this->tilesX * this->tilesZ; i++) {
+		if (this->tileMax[i] > 0) this->active.push_back(i);
+	}
+	this->dirty.assign(this->tilesX * this->tilesZ, 0);
+	this->anyDirty = false;
+}
+
+bool RiseAnimation::advance(TerrainState &terrain, double seconds) {
+	if (this->active.empty()) return false;
+
+	// everything reaches its height exactly at the end, whatever the rounding
+	float level = seconds >= this->duration ? this->max_height : (float)(this->max_height * (seconds / this->duration));
+
+	size_t kept = 0;
+	for (size_t i = 0; i < this->active.size(); i++) {
+		int tile = this->active[i];
+		int x0 = (tile / this->tilesZ) * TILE_SIZE;
+		int z0 = (tile % this->tilesZ) * TILE_SIZE;
+		int x1 = std::min(x0 + TILE_SIZE, this->x_size);
+		int z1 = std::min(z0 + TILE_SIZE, this->z_size);
+
+		for (int x = x0; x < x1; x++) {
+			const float *target = terrain.heightmap.row(x);
+			float *current = terrain.currentheight.row(x);
+			for (int z = z0; z < z1; z++) {
+				current[z] = std::min(target[z], level);
+			}
+		}
+		this->dirty[tile] = 1;
+
+		// keep the tile until the level has gone past its highest point
+		if (this->tileMax[tile] > level) this->active[kept++] = tile;
+	}
+	this->active.resize(kept);
+	this->anyDirty = true;
+	return true;
+}
+
+bool RiseAnimation::takeDirty(std::vector<TerrainRegion> &regions, TerrainRegion &bounds) {
+	regions.clear();
+	if (!this->anyDirty) return false;
+
+	bounds.x0 = this->x_size;
+	bounds.z0 = this->z_size;
+	bounds.x1 = 0;
+	bounds.z1 = 0;
+	for (int tx = 0; tx < this->tilesX; tx++) {
+		// the dirty columns in this row of tiles
+		int first = -1, last = -1;
+		for (int tz = 0; tz < this->tilesZ; tz++) {
+			unsigned char &d = this->dirty[tx * this->tilesZ + tz];
+			if (!d) continue;
+			d = 0;
+			if (first < 0) first = tz;
+			last = tz;
+		}
+		if (first < 0) continue;
+
+		TerrainRegion region;
+		region.x0 = tx * TILE_SIZE;
+		region.x1 = std::min(region.x0 + TILE_SIZE, this->x_size);
+		region.z0 = first * TILE_SIZE;
+		region.z1 = std::min((last + 1) * TILE_SIZE, this->z_size);
+
+		// rows of tiles that follow each other are uploaded together
+		if (!regions.empty() && regions.back().x1 == region.x0) {
+			TerrainRegion &previous = regions.back();
+			previous.x1 = region.x1;
+			previous.z0 = std::min(previous.z0, region.z0);
+			previous.z1 = std::max(previous.z1, region.z1);
+		} else {
+			regions.push_back(region);
+		}
+
+		bounds.x0 = std::min(bounds.x0, region.x0);
+		bounds.z0 = std::min(bounds.z0, region.z0);
+		bounds.x1 = std::max(bounds.x1, region.x1);
+		bounds.z1 = std::max(bounds.z1, region.z1);
+	}
+	this->anyDirty = false;
+	return !regions.empty();
+}
@@ -0,0 +1,65 @@
+#ifndef RISE_ANIMATION_H
+#define RISE_ANIMATION_H
+
+#include "terrainGenerator.h"
+#include <vector>
+
+/**
+* A rectangle of the grid: rows [x0, x1) and columns [z0, z1).
+*/
+struct TerrainRegion {
+	int x0, z0;
+	int x1, z1;
+};
+
+/**
+* Animates currentheight rising from flat up to heightmap.
+*
+* The animation is time based: a water level rises from 0 to max_height over
+* a fixed duration and every point follows it until it reaches its own
+* height. The grid is split into tiles that each know their highest point,
+* so only tiles that are still rising are touched, the tiles that changed
+* are remembered for uploading, and once the level passes the highest
+* point there's nothing left to do.
+*/
+class RiseAnimation {
+public:
+	// size of the (square) tiles, in cells
+	static const int TILE_SIZE = 32;
+
+	RiseAnimation();
+
+	// starts the animation for a freshly generated terrain (currentheight all 0)
+	// lasting duration seconds
+	void start(const TerrainState &terrain, double duration);
+
+	// moves the animation to seconds after it was started, updating currentheight
+	// in the tiles that are still rising. returns true if any heights changed.
+	bool advance(TerrainState &terrain, double seconds);
+
+	// whether every point has reached its height
+	bool settled() const { return this->active.empty(); }
+
+	// hands over the regions that changed since the last call, one per row of
+	// tiles with changes (merged with the next row of tiles when they touch),
+	// plus the rectangle around all of them. returns false if nothing changed.
+	bool takeDirty(std::vector<TerrainRegion> &regions, TerrainRegion &bounds);
+
+private:
+	int tilesX;
+	int tilesZ;
+	int x_size;
+	int z_size;
+	double duration;
+	float max_height;
+
+	// highest point of each tile of heightmap
+	std::vector<float> tileMax;
+	// tiles that are still rising
+	std::vector<int> active;
+	// tiles that changed since the last takeDirty()
+	std::vector<unsigned char> dirty;
+	bool anyDirty;
+};
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef SCENE_LIGHTS_H
+#define SCENE_LIGHTS_H
+
+// the number of lights over the terrain
+#define SCENE_LIGHT_COUNT 2
+
+// how fast light falls off with distance, the GL_LINEAR_ATTENUATION a Light sets
+// (with no constant term, so it brightens up close)
+#define SCENE_LIGHT_ATTENUATION 0.02f
+
+// the terrain's ambient and diffuse material as fractions of its ramp color, as the
+// per-vertex materials it was first drawn with had them
+#define TERRAIN_MATERIAL_AMBIENT 0.3f
+#define TERRAIN_MATERIAL_DIFFUSE 0.6f
+
+/**
+* A point light over the terrain, without anything GL in it so it can be
+* used where there's no GL at all.
+*/
+struct SceneLight {
+	float position[4];
+	float ambient[4];
+	float diffuse[4];
+	float specular[4];
+};
+
+/**
+* The lights the terrain is drawn with, placed from its size: one over each
+* of two opposite corners, higher for bigger terrains.
+*/
+inline void sceneLights(int x_size, int z_size, SceneLight lights[SCENE_LIGHT_COUNT]) {
+	float height = ((float)(x_size + z_size) / 80) + 10;
+	SceneLight corner = {
+		{0, height, 0, 1},
+		{0.3, 0.3, 0.3, 1.0},
+		{0.7, 0.7, 0.7, 1.0},
+		{1.0, 1.0, 1.0, 1.0}
+	};
+	SceneLight opposite = {
+		{(float)x_size, height, (float)z_size, 1},
+		{0.3, 0.3, 0.3, 1.0},
+		{0.5, 0.5, 0.5, 1.0},
+		{0.7, 0.7, 0.7, 1.0}
+	};
+	lights[0] = corner;
+	lights[1] = opposite;
+}
+
+#endif
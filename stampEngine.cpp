@@ -0,0 +1,114 @@
+#include "stampEngine.h"
+#include <cmath>
+#include <algorithm>
+
+StampEngine::StampEngine() {
+	this->radius = -1;
+}
+
+/**
+* Builds the falloff table for circles of the given diameter.
+* The values are computed exactly the way the full-grid algorithm computed
+* them per cell, so stamping through the table gives identical heights.
+*/
+void StampEngine::setup(float terrainCircleSize) {
+	this->falloff.clear();
+	this->span.clear();
+
+	// walk outwards through the squared distances until we leave the circle
+	for (int d2 = 0; ; d2++) {
+		float dist = sqrt((double)d2);
+		float pd = (dist * 2) / terrainCircleSize;
+		if (!(fabs(pd) <= 1.0)) break;
+		this->falloff.push_back(cos(pd*3.14));
+	}
+
+	int maxD2 = (int)this->falloff.size() - 1;
+	this->radius = maxD2 < 0 ? -1 : (int)sqrt((double)maxD2);
+	// make sure rounding in sqrt didn't leave the radius off by one
+	while ((this->radius+1) * (this->radius+1) <= maxD2) this->radius++;
+	while (this->radius >= 0 && this->radius * this->radius > maxD2) this->radius--;
+
+	// for each row offset, the furthest column offset still inside the circle
+	for (int dx = 0; dx <= this->radius; dx++) {
+		int dz = this->radius;
+		while (dx*dx + dz*dz > maxD2) dz--;
+		this->span.push_back(dz);
+	}
+}
+
+/**
+* Adds one circle to the heightmap, only visiting cells inside it.
+*/
+void StampEngine::apply(Grid<float> &heights, int tx, int tz, float disp, float &max_height) const {
+	this->apply(heights, tx, tz, disp, max_height, 0, heights.x_size);
+}
+
+/**
+* Adds the part of one circle inside rows [x0, x1).
+*/
+void StampEngine::apply(Grid<float> &heights, int tx, int tz, float disp, float &max_height, int x0, int x1) const {
+	if (this->radius < 0) return;
+	int z_size = heights.z_size;
+
+	// clamp the bounding box of the circle to the rows
+	int i0 = tx - this->radius < x0 ? x0 : tx - this->radius;
+	int i1 = tx + this->radius > x1 - 1 ? x1 - 1 : tx + this->radius;
+
+	for (int i = i0; i <= i1; i++) {
+		int dx = i - tx;
+		int half = this->span[dx < 0 ? -dx : dx];
+		int j0 = tz - half < 0 ? 0 : tz - half;
+		int j1 = tz + half > z_size - 1 ? z_size - 1 : tz + half;
+
+		float *row = heights.row(i);
+		for (int j = j0; j <= j1; j++) {
+			int dz = j - tz;
+			row[j] += disp/2 + (this->falloff[dx*dx + dz*dz]*disp)/2;
+			if (row[j] > max_height) max_height = row[j];
+		}
+	}
+}
+
+/**
+* Goes through the tiles the circle's bounding box overlaps, adding the part
+* of the circle inside each one, so only those tiles are paged in.
+*/
+void StampEngine::apply(TileStore &store, int tx, int tz, float disp, float &max_height) const {
+	if (this->radius < 0) return;
+	const int size = TileStore::TILE_SIZE;
+
+	int i0 = tx - this->radius < 0 ? 0 : tx - this->radius;
+	int i1 = tx + this->radius > store.x_size - 1 ? store.x_size - 1 : tx + this->radius;
+	int j0 = tz - this->radius < 0 ? 0 : tz - this->radius;
+	int j1 = tz + this->radius > store.z_size - 1 ? store.z_size - 1 : tz + this->radius;
+	if (i0 > i1 || j0 > j1) return;
+
+	for (int tileX = i0 / size; tileX <= i1 / size; tileX++) {
+		int r0 = std::max(i0, tileX * size);
+		int r1 = std::min(i1, tileX * size + size - 1);
+		for (int tileZ = j0 / size; tileZ <= j1 / size; tileZ++) {
+			int c0 = std::max(j0, tileZ * size);
+			int c1 = std::min(j1, tileZ * size + size - 1);
+
+			float *tile = NULL;
+			for (int i = r0; i <= r1; i++) {
+				int dx = i - tx;
+				int half = this->span[dx < 0 ? -dx : dx];
+				int a = std::max(c0, tz - half);
+				int b = std::min(c1, tz + half);
+				if (a > b) continue;
+
+				// corner tiles of the bounding box can miss the circle entirely
+				if (!tile) tile = store.writableTile(tileX, tileZ);
+				float *row = tile + (i - tileX * size) * size;
+				for (int j = a; j <= b; j++) {
+					int dz = j - tz;
+					float &h = row[j - tileZ * size];
+					h += disp/2 + (this->falloff[dx*dx + dz*dz]*disp)/2;
+					if (h > max_height) max_height = h;
+				}
+			}
+		}
+	}
+}
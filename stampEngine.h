@@ -0,0 +1,57 @@
+#ifndef STAMP_ENGINE_H
+#define STAMP_ENGINE_H
+
+#include <vector>
+#include "grid.h"
+#include "tileStore.h"
+
+/**
+* One circle of the terrain algorithm: its center and how much it raises the ground.
+*/
+struct Circle {
+	int x;
+	int z;
+	float disp;
+};
+
+/**
+* Applies circles of the terrain algorithm to a heightmap, visiting only
+* the cells inside each circle instead of the whole grid.
+*
+* Stamp centers are always on grid points, so the squared distance from the
+* center to any cell is an integer. The cosine falloff is precomputed for
+* every squared distance inside the circle, and each row of the circle's
+* bounding box knows how far it extends, so no distance or cos is computed
+* per cell.
+*/
+class StampEngine {
+public:
+	StampEngine();
+
+	// precomputes the falloff table for circles of the given diameter
+	void setup(float terrainCircleSize);
+
+	// adds a circle of displacement disp centered on (tx, tz) to heights,
+	// raising max_height if any modified cell goes above it
+	void apply(Grid<float> &heights, int tx, int tz, float disp, float &max_height) const;
+
+	// the same, only touching rows [x0, x1) of heights. the part of a circle in each
+	// row gets the same additions either way, so a grid can be stamped a band at a time
+	void apply(Grid<float> &heights, int tx, int tz, float disp, float &max_height, int x0, int x1) const;
+
+	// the same for a heightmap in a tile store, a tile at a time. every cell gets
+	// exactly the same additions in the same order, so the heights are identical.
+	void apply(TileStore &store, int tx, int tz, float disp, float &max_height) const;
+
+	// radius (in cells) of the bounding box of a circle
+	int radius;
+
+private:
+	// cos(pd*3.14) for each integer squared distance inside the circle
+	std::vector<double> falloff;
+
+	// half-width (in cells along z) of the circle for each x offset
+	std::vector<int> span;
+};
+
+#endif
@@ -0,0 +1,199 @@
+#include "terrainGenerator.h"
+#include "heightmapFile.h"
+#include "rayMarcher.h"
+#include "cameraPath.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <cstdio>
+
+// headless batch generator: no GL, no window.
+// usage: TerrainGen <x_size> <z_size> <count> <seed> [output prefix] [--compact [--normals]] [--store] [--budget <MB>] [--threads <n>]
+//        [--preview <width>x<height>]
+// terrain i is generated with seed+i and written to <prefix><seed+i>.pgm, or with --compact to
+// <prefix><seed+i>.thc in the format the viewer loads (see heightmapFile.h), or with --store
+// generated straight into a tiled heightmap <prefix><seed+i>.thm (see tileStore.h) keeping
+// at most --budget MB of it in memory, so it can be bigger than memory.
+// the circles are stamped on --threads threads (one per core by default); the
+// terrain for a seed is the same whatever the thread count.
+// --preview also renders each in-memory terrain on the CPU (see rayMarcher.h) to
+// <prefix><seed+i>.ppm, seen from where the viewer's --headless orbit starts
+
+/**
+* Writes the heightmap as a binary 16-bit PGM, scaled against max_height.
+* The max height is stored in a comment so the real heights can be recovered.
+*/
+bool writeHeightmap(const TerrainState &state, const std::string &filename) {
+	std::ofstream out(filename.c_str(), std::ios::binary);
+	if (!out) return false;
+
+	// the PGM is written with x across and z down
+	out << "P5\n# max_height " << state.max_height << "\n" << state.x_size << " " << state.z_size << "\n65535\n";
+
+	std::vector<unsigned char> row(state.x_size * 2);
+	for (int j = 0; j < state.z_size; j++) {
+		for (int i = 0; i < state.x_size; i++) {
+			float h = state.heightmap(i, j) / state.max_height;
+			if (h < 0) h = 0;
+			if (h > 1) h = 1;
+			unsigned int v = (unsigned int)(h * 65535 + 0.5);
+			// PGM samples are big endian
+			row[2*i] = (v >> 8) & 0xff;
+			row[2*i + 1] = v & 0xff;
+		}
+		out.write(reinterpret_cast<const char*>(&row[0]), row.size());
+	}
+	return out.good();
+}
+
+/**
+* Writes RGB pixels, top row first, as a binary PPM.
+*/
+bool writePreview(const std::vector<unsigned char> &pixels, int width, int height, const std::string &filename) {
+	std::ofstream out(filename.c_str(), std::ios::binary);
+	if (!out) return false;
+	out << "P6\n" << width << " " << height << "\n255\n";
+	out.write(reinterpret_cast<const char*>(&pixels[0]), pixels.size());
+	return out.good();
+}
+
+int main(int argc, char** argv)
+{
+	// the options can go anywhere, everything else is positional
+	std::vector<const char*> args;
+	bool tiled = false;
+	bool compact = false;
+	bool normals = false;
+	double budget = 256;
+	int threads = 0;
+	int previewWidth = 0, previewHeight = 0;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--store") == 0) tiled = true;
+		else if (strcmp(argv[i], "--compact") == 0) compact = true;
+		else if (strcmp(argv[i], "--normals") == 0) normals = true;
+		else if (strcmp(argv[i], "--budget") == 0 && i + 1 < argc) budget = atof(argv[++i]);
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--preview") == 0 && i + 1 < argc) {
+			if (sscanf(argv[++i], "%dx%d", &previewWidth, &previewHeight) != 2 || previewWidth < 1 || previewHeight < 1) {
+				std::cout << "preview size must be <width>x<height>" << std::endl;
+				return -1;
+			}
+		}
+		else args.push_back(argv[i]);
+	}
+
+	if (args.size() != 4 && args.size() != 5) {
+		std::cout << "usage: " << argv[0] << " <x_size> <z_size> <count> <seed> [output prefix] [--compact [--normals]] [--store] [--budget <MB>] [--threads <n>] [--preview <width>x<height>]" << std::endl;
+		return -1;
+	}
+	int x_size = atoi(args[0]);
+	int z_size = atoi(args[1]);
+	int count = atoi(args[2]);
+	unsigned int seed = strtoul(args[3], NULL, 10);
+	std::string prefix = args.size() == 5 ? args[4] : "terrain_";
+
+	if (x_size < 1 || z_size < 1 || count < 1) {
+		std::cout << "sizes and count must be positive" << std::endl;
+		return -1;
+	}
+
+	TerrainState state;
+	TileStore store;
+	store.setBudget((size_t)(budget * 1024 * 1024));
+	TerrainGenerator generator;
+	generator.threads = threads;
+	TerrainTimings totals = TerrainTimings();
+	double writeTotal = 0;
+
+	// previews are lit and colored the way the viewer draws them, with its default ramp
+	RayMarcher marcher;
+	marcher.threads = threads;
+	ColorRamp ramp;
+	CameraPath path;
+	path.setOrbit(x_size, z_size, 1);
+	Viewpoint view = path.points[0];
+	Vec3D front = Vec3D(view.target.mX - view.eye.mX, view.target.mY - view.eye.mY, view.target.mZ - view.eye.mZ);
+	SceneLight lights[SCENE_LIGHT_COUNT];
+	sceneLights(x_size, z_size, lights);
+	std::vector<unsigned char> preview((size_t)previewWidth * previewHeight * 3);
+	if (previewWidth > 0 && tiled) std::cout << "a stored terrain isn't in memory, so it has no preview" << std::endl;
+
+	std::chrono::steady_clock::time_point runStart = std::chrono::steady_clock::now();
+	for (int n = 0; n < count; n++) {
+		std::stringstream filename;
+		filename << prefix << (seed + n) << (tiled ? ".thm" : (compact ? ".thc" : ".pgm"));
+		double write;
+
+		if (tiled) {
+			const char *error = NULL;
+			if (!generator.generate(store, filename.str().c_str(), x_size, z_size, seed + n, &error)) {
+				std::cout << "could not create " << filename.str() << ": " << error << std::endl;
+				return -1;
+			}
+			// the heights are already in the file, closing only writes the header
+			std::chrono::steady_clock::time_point writeStart = std::chrono::steady_clock::now();
+			long pageIns = store.pageIns;
+			long evictions = store.evictions;
+			int peak = store.peakResident;
+			store.close();
+			write = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - writeStart).count();
+			std::cout << filename.str() << " page-ins=" << pageIns << " evictions=" << evictions
+				<< " peak-resident=" << peak << "/" << store.budgetTiles() << " tiles" << std::endl;
+		} else {
+			generator.generate(state, x_size, z_size, seed + n);
+			std::chrono::steady_clock::time_point writeStart = std::chrono::steady_clock::now();
+			const char *error = "could not write the file";
+			bool written = compact ? saveTerrain(state, filename.str().c_str(), normals, &error) : writeHeightmap(state, filename.str());
+			if (!written) {
+				std::cout << "could not write " << filename.str() << ": " << error << std::endl;
+				return -1;
+			}
+			write = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - writeStart).count();
+
+			if (previewWidth > 0) {
+				std::stringstream previewName;
+				previewName << prefix << (seed + n) << ".ppm";
+				std::chrono::steady_clock::time_point renderStart = std::chrono::steady_clock::now();
+				marcher.build(state);
+				// the viewer's 90 degree field of view and clip planes
+				marcher.render(state, view.eye, front, 90, 0.1, 1000, lights, ramp, previewWidth, previewHeight, &preview[0]);
+				double render = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - renderStart).count();
+				if (!writePreview(preview, previewWidth, previewHeight, previewName.str())) {
+					std::cout << "could not write " << previewName.str() << std::endl;
+					return -1;
+				}
+				std::cout << previewName.str() << " render=" << render << " cells/ray="
+					<< (double)marcher.cellsVisited / ((double)previewWidth * previewHeight) << std::endl;
+			}
+		}
+
+		// per-terrain stage times, in ms
+		std::cout << filename.str()
+			<< " allocate=" << generator.timings.allocate
+			<< " stamp=" << generator.timings.stamp
+			<< " normals=" << generator.timings.normals
+			<< " write=" << write << std::endl;
+
+		totals.allocate += generator.timings.allocate;
+		totals.stamp += generator.timings.stamp;
+		totals.normals += generator.timings.normals;
+		writeTotal += write;
+	}
+	double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count();
+
+	// totals and throughput over the whole batch
+	std::cout << "total allocate=" << totals.allocate
+		<< " stamp=" << totals.stamp
+		<< " normals=" << totals.normals
+		<< " write=" << writeTotal << std::endl;
+	std::cout << count << " terrains in " << wall << "s: "
+		<< (count / wall) << " terrains/s, "
+		<< ((double)x_size * z_size * count / wall / 1e6) << " Mcells/s" << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,221 @@
+#include "terrainGenerator.h"
+#include "mathLib3D.h"
+#include "normalKernel.h"
+#include "counterRng.h"
+#include "parallelFor.h"
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+
+// circles applied between updates of the generator's progress
+static const int PROGRESS_INTERVAL = 256;
+
+// returns milliseconds elapsed since start
+static double elapsedMs(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+TerrainState::TerrainState() {
+	this->x_size = 0;
+	this->z_size = 0;
+	this->max_height = 1;
+	this->seed = 0;
+	this->params = TerrainGenerator::params(0, 0);
+}
+
+TerrainState::~TerrainState() {
+	this->release();
+}
+
+/**
+* Frees the storage of the grids.
+*/
+void TerrainState::release() {
+	this->heightmap.release();
+	this->currentheight.release();
+	this->normals.release();
+	this->x_size = 0;
+	this->z_size = 0;
+}
+
+/**
+* Sizes the grids to x_size * z_size and zeroes them.
+*/
+void TerrainState::allocate(int x_size, int z_size) {
+	this->x_size = x_size;
+	this->z_size = z_size;
+	this->max_height = 1;
+
+	this->heightmap.resize(x_size, z_size);
+	this->heightmap.fill(0);
+	this->currentheight.resize(x_size, z_size);
+	this->currentheight.fill(0);
+	this->normals.resize(x_size, z_size);
+	this->normals.fill(Vec3D());
+}
+
+/**
+* Swaps the grids' storage rather than their contents, so it takes no time
+* whatever the size of the terrain.
+*/
+void TerrainState::swap(TerrainState &other) {
+	std::swap(this->x_size, other.x_size);
+	std::swap(this->z_size, other.z_size);
+	std::swap(this->max_height, other.max_height);
+	std::swap(this->seed, other.seed);
+	std::swap(this->params, other.params);
+	this->heightmap.swap(other.heightmap);
+	this->currentheight.swap(other.currentheight);
+	this->normals.swap(other.normals);
+}
+
+double TerrainTimings::total() const {
+	return allocate + stamp + normals;
+}
+
+TerrainGenerator::TerrainGenerator() {
+	this->timings.allocate = 0;
+	this->timings.stamp = 0;
+	this->timings.normals = 0;
+	this->threads = 0;
+	this->cancelled.store(false);
+	this->progress.store(0);
+}
+
+/**
+* The circles get smaller and gentler as the terrain gets smaller, and there are fewer of them.
+*/
+GeneratorParams TerrainGenerator::params(int x_size, int z_size) {
+	GeneratorParams params;
+	params.circleSize = (x_size + z_size) / 20;
+	params.displacement = (x_size + z_size) / 80;
+	params.decay = 1.0005;
+	// do (x_size+z_size)*2.5 iterations of terrain algorithm
+	params.circles = (int)ceil((x_size + z_size) * 2.5);
+	return params;
+}
+
+/**
+* Generates a new heightmap into state. The same size and seed always
+* produce the same terrain.
+*/
+void TerrainGenerator::generate(TerrainState &state, int x_size, int z_size, unsigned int seed) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	state.allocate(x_size, z_size);
+	state.seed = seed;
+	state.params = params(x_size, z_size);
+	this->timings.allocate = elapsedMs(start);
+
+	start = std::chrono::steady_clock::now();
+	this->placeCircles(x_size, z_size, seed);
+	this->stampCircles(state.heightmap, state.max_height);
+	this->timings.stamp = elapsedMs(start);
+	if (this->cancelled.load()) return;
+
+	start = std::chrono::steady_clock::now();
+	this->computeNormals(state);
+	this->timings.normals = elapsedMs(start);
+	this->progress.store(1, std::memory_order_relaxed);
+}
+
+/**
+* The circles land in exactly the same places as they do for a TerrainState,
+* so the heights match it bit for bit.
+*/
+bool TerrainGenerator::generate(TileStore &store, const char *file, int x_size, int z_size, unsigned int seed,
+		const char **error) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if (!store.create(file, x_size, z_size, error)) return false;
+	store.seed = seed;
+	this->timings.allocate = elapsedMs(start);
+
+	start = std::chrono::steady_clock::now();
+	this->placeCircles(x_size, z_size, seed);
+	this->stampCircles(store, store.max_height);
+	this->timings.stamp = elapsedMs(start);
+	this->timings.normals = 0;
+	this->progress.store(1, std::memory_order_relaxed);
+	return true;
+}
+
+/**
+* Each circle's center takes two numbers from the seed's stream, so circle i
+* is the same however many come before it. The displacements shrink by the
+* same division as always, which is cheap enough to do in order.
+*/
+void TerrainGenerator::placeCircles(int x_size, int z_size, unsigned int seed) {
+	GeneratorParams params = TerrainGenerator::params(x_size, z_size);
+	this->stamper.setup(params.circleSize);
+	CounterRng rng(seed);
+	this->circles.resize(params.circles);
+	float disp = params.displacement;
+	for (int i = 0; i < params.circles; i++) {
+		// centers can land on the far edges, just outside the grid
+		this->circles[i].x = rng.below(2 * (uint64_t)i, x_size + 1);
+		this->circles[i].z = rng.below(2 * (uint64_t)i + 1, z_size + 1);
+		this->circles[i].disp = disp;
+		disp /= params.decay;
+	}
+}
+
+/**
+* Bands only share the rows a circle spans, never cells, so they can be
+* stamped at the same time. Each band keeps its own max height, and the
+* largest of them is the same as the one stamping in order would find.
+*/
+void TerrainGenerator::stampCircles(Grid<float> &heights, float &max_height) {
+	this->progress.store(0, std::memory_order_relaxed);
+	int x_size = heights.x_size;
+	int bandCount = (x_size + BAND_ROWS - 1) / BAND_ROWS;
+	if (this->stamper.radius < 0 || bandCount < 1) return;
+
+	// hand each circle to the bands it reaches, keeping them in order
+	this->bands.resize(bandCount);
+	for (int b = 0; b < bandCount; b++) this->bands[b].clear();
+	for (size_t i = 0; i < this->circles.size(); i++) {
+		int x0 = this->circles[i].x - this->stamper.radius;
+		int x1 = std::min(this->circles[i].x + this->stamper.radius, x_size - 1);
+		for (int b = std::max(x0, 0) / BAND_ROWS; b <= x1 / BAND_ROWS && x0 <= x1; b++) {
+			this->bands[b].push_back(i);
+		}
+	}
+
+	std::vector<float> bandMax(bandCount, max_height);
+	std::atomic<int> finished(0);
+	parallelFor(bandCount, this->threads, [&](int b) {
+		if (this->cancelled.load(std::memory_order_relaxed)) return;
+		int x0 = b * BAND_ROWS;
+		int x1 = std::min(x0 + BAND_ROWS, x_size);
+		const std::vector<int> &band = this->bands[b];
+		for (size_t k = 0; k < band.size(); k++) {
+			const Circle &circle = this->circles[band[k]];
+			this->stamper.apply(heights, circle.x, circle.z, circle.disp, bandMax[b], x0, x1);
+		}
+		this->progress.store((float)++finished / bandCount, std::memory_order_relaxed);
+	});
+	for (int b = 0; b < bandCount; b++) max_height = std::max(max_height, bandMax[b]);
+}
+
+void TerrainGenerator::stampCircles(TileStore &store, float &max_height) {
+	this->progress.store(0, std::memory_order_relaxed);
+	for (size_t i = 0; i < this->circles.size(); i++) {
+		if (i % PROGRESS_INTERVAL == 0) {
+			if (this->cancelled.load(std::memory_order_relaxed)) return;
+			this->progress.store((float)i / this->circles.size(), std::memory_order_relaxed);
+		}
+		const Circle &circle = this->circles[i];
+		this->stamper.apply(store, circle.x, circle.z, circle.disp, max_height);
+	}
+}
+
+// circle terrain generation algorithm
+void TerrainGenerator::stamp(TerrainState &state, int tx, int tz, float disp) {
+	this->stamper.apply(state.heightmap, tx, tz, disp, state.max_height);
+}
+
+/**
+* Computes the average vertex normal from all intersections.
+*/
+void TerrainGenerator::computeNormals(TerrainState &state) {
+	computeVertexNormals(state.heightmap, state.normals);
+}
@@ -0,0 +1,156 @@
+#ifndef TERRAIN_GENERATOR_H
+#define TERRAIN_GENERATOR_H
+
+#include "mathLib3D.h"
+#include "stampEngine.h"
+#include "grid.h"
+#include "tileStore.h"
+#include <atomic>
+#include <vector>
+
+/**
+* The settings the circle algorithm uses for a terrain, which all follow from its size.
+*/
+struct GeneratorParams {
+	// diameter of the circles
+	float circleSize;
+	// displacement of the first circle, each one after it is divided by decay
+	float displacement;
+	double decay;
+	// number of circles
+	int circles;
+};
+
+/**
+* Holds all of the per-vertex data for one terrain.
+* Nothing in here touches GL, so terrains can be generated without a window.
+*/
+class TerrainState {
+public:
+	TerrainState();
+	~TerrainState();
+
+	// size of the grid x, z
+	int x_size;
+	int z_size;
+
+	// maximum height in the heightmap
+	float max_height;
+
+	// what it was generated with
+	unsigned int seed;
+	GeneratorParams params;
+
+	// the height grids (final heights and the animated heights)
+	Grid<float> heightmap;
+	Grid<float> currentheight;
+
+	// normal vectors for each vertex
+	Grid<Vec3D> normals;
+
+	// sizes the grids for the given size, zeroing everything.
+	// the grids keep their storage if it's already big enough.
+	void allocate(int x_size, int z_size);
+
+	// frees the grids
+	void release();
+
+	// exchanges everything with other. only the grids' pointers move, so this is
+	// how a terrain generated into another state is swapped in
+	void swap(TerrainState &other);
+
+private:
+	// the grids are owned by the state, so it can't be copied
+	TerrainState(const TerrainState &other);
+	TerrainState &operator=(const TerrainState &other);
+};
+
+/**
+* Wall time (in milliseconds) spent in each stage of the last generate() call.
+*/
+struct TerrainTimings {
+	double allocate;
+	double stamp;
+	double normals;
+
+	double total() const;
+};
+
+/**
+* Generates terrain into a TerrainState using the circle algorithm.
+*
+* Where each circle lands comes from a counter-based generator (see
+* counterRng.h), so the same size and seed give the same terrain on any
+* machine. The circles are placed first, then the grid is cut into bands of
+* rows that are stamped in parallel, each applying the circles that reach it
+* in their original order. Every cell gets the same additions in the same
+* order as stamping the whole grid one circle at a time, so the heights
+* don't depend on the number of threads.
+*/
+class TerrainGenerator {
+public:
+	// rows in each band of the grid that's stamped on its own
+	static const int BAND_ROWS = 64;
+
+	TerrainGenerator();
+
+	// the settings used for a terrain of the given size
+	static GeneratorParams params(int x_size, int z_size);
+
+	// generates a new heightmap of the given size into state from seed
+	void generate(TerrainState &state, int x_size, int z_size, unsigned int seed);
+
+	// generates the same terrain straight into a new tile store in file, so it never has to
+	// fit in memory. the store is left open for writing. normals aren't stored, they're
+	// worked out from the heights when they're read (see terrainSource.h).
+	// on failure returns false and points error at a description.
+	bool generate(TileStore &store, const char *file, int x_size, int z_size, unsigned int seed, const char **error);
+
+	// applies a single circle of displacement disp centered on (tx, tz),
+	// keeping max_height up to date as it goes
+	void stamp(TerrainState &state, int tx, int tz, float disp);
+
+	// computes the average vertex normal from all intersections
+	void computeNormals(TerrainState &state);
+
+	// how far the generate() call in progress has got, from 0 to 1: the share of
+	// the bands (or circles, for a store) stamped so far. it's updated as it goes,
+	// so other threads can watch it
+	std::atomic<float> progress;
+
+	// set from another thread to make a generate() call in progress stop early,
+	// leaving the terrain unfinished. it stays set until it's cleared
+	std::atomic<bool> cancelled;
+
+	// threads to stamp with, 0 (the default) for one per core
+	int threads;
+
+	// timings of the last generate() call
+	TerrainTimings timings;
+
+	// applies the circles, set up for the grid size of the last generate()
+	StampEngine stamper;
+
+private:
+	// the generator's progress is read by other threads, so it can't be copied
+	TerrainGenerator(const TerrainGenerator &other);
+	TerrainGenerator &operator=(const TerrainGenerator &other);
+
+	// works out every circle of a terrain of the given size into circles,
+	// and sets up the stamper for them
+	void placeCircles(int x_size, int z_size, unsigned int seed);
+
+	// applies the circles to a grid, a band of rows per thread
+	void stampCircles(Grid<float> &heights, float &max_height);
+
+	// applies the circles to a tile store one at a time, since it pages tiles in and out
+	void stampCircles(TileStore &store, float &max_height);
+
+	// the circles of the terrain being generated, in the order they're applied
+	std::vector<Circle> circles;
+
+	// for each band of rows, the indices of the circles that reach it
+	std::vector<std::vector<int> > bands;
+};
+
+#endif
@@ -0,0 +1,241 @@
+#include "terrainMesh.h"
+#include <algorithm>
+#include <cmath>
+
+int chunkCount(int cells) {
+	if (cells <= 0) return 0;
+	return std::max(1, cells / CHUNK_SIZE);
+}
+
+int chunkStart(int k) {
+	return k * CHUNK_SIZE;
+}
+
+/**
+* The last chunk runs to the end of the grid.
+*/
+int chunkCells(int k, int cells) {
+	if (k == chunkCount(cells) - 1) return cells - chunkStart(k);
+	return CHUNK_SIZE;
+}
+
+int levelVertexCount(int n, int level) {
+	int step = 1 << level;
+	return n / step + 1 + (n % step != 0);
+}
+
+int levelVertexPosition(int i, int n, int level) {
+	return std::min(i << level, n);
+}
+
+int chunkMaxLevel(int nx, int nz) {
+	int n = std::min(nx, nz);
+	int level = 0;
+	while (level + 1 < CHUNK_LEVELS && (n >> (level + 1)) >= 2) level++;
+	return level;
+}
+
+/**
+* Picks the vertices of the level out of the full resolution points.
+*/
+void assembleChunkVertices(const float *heights, const Vec3D *normals, int stride, float max_height,
+		const ColorRamp &ramp, int x0, int z0, int nx, int nz, int level, TerrainVertex *out) {
+	int vx = levelVertexCount(nx, level);
+	int vz = levelVertexCount(nz, level);
+	for (int i = 0; i < vx; i++) {
+		int dx = levelVertexPosition(i, nx, level);
+		const float *heightRow = heights + (size_t)dx * stride;
+		const Vec3D *normalRow = normals + (size_t)dx * stride;
+		for (int j = 0; j < vz; j++) {
+			int dz = levelVertexPosition(j, nz, level);
+			TerrainVertex &v = *out++;
+			v.position[0] = x0 + dx;
+			v.position[1] = heightRow[dz];
+			v.position[2] = z0 + dz;
+			v.normal[0] = normalRow[dz].mX;
+			v.normal[1] = normalRow[dz].mY;
+			v.normal[2] = normalRow[dz].mZ;
+			v.texcoord[0] = x0 + dx;
+			v.texcoord[1] = z0 + dz;
+			const unsigned char *color = ramp.lookup(heightRow[dz], max_height);
+			v.color[0] = color[0];
+			v.color[1] = color[1];
+			v.color[2] = color[2];
+			v.color[3] = color[3];
+		}
+	}
+}
+
+namespace {
+
+// a vertex on one of the chains being zipped together, and how far along the side it is
+struct ChainVertex {
+	unsigned short index;
+	int along;
+};
+
+// the chunk's vertex lattice at one level
+struct Lattice {
+	int nx, nz, level;
+	int vx, vz;
+
+	unsigned short index(int i, int j) const { return i * this->vz + j; }
+	int x(int i) const { return levelVertexPosition(i, this->nx, this->level); }
+	int z(int j) const { return levelVertexPosition(j, this->nz, this->level); }
+
+	// adds a triangle, flipping it if needed so it's counter-clockwise seen from above.
+	// that's the same way round as the quads: (x,z+1), (x+1,z+1), (x+1,z) has a negative cross product.
+	void triangle(std::vector<unsigned short> &out, unsigned short a, unsigned short b, unsigned short c) const {
+		int ax = this->x(a / this->vz), az = this->z(a % this->vz);
+		int bx = this->x(b / this->vz), bz = this->z(b % this->vz);
+		int cx = this->x(c / this->vz), cz = this->z(c % this->vz);
+		long cross = (long)(bx - ax) * (cz - az) - (long)(bz - az) * (cx - ax);
+		out.push_back(a);
+		if (cross > 0) {
+			out.push_back(c);
+			out.push_back(b);
+		} else {
+			out.push_back(b);
+			out.push_back(c);
+		}
+	}
+
+	// one cell from vertex (i, j) to (i+1, j+1), as a quad or as two triangles
+	// split along the same diagonal the triangle strips always used
+	void cell(std::vector<unsigned short> &tris, std::vector<unsigned short> &quads, bool asQuad, int i, int j) const {
+		unsigned short a = this->index(i, j+1);
+		unsigned short b = this->index(i+1, j+1);
+		unsigned short c = this->index(i+1, j);
+		unsigned short d = this->index(i, j);
+		if (asQuad) {
+			quads.push_back(a);
+			quads.push_back(b);
+			quads.push_back(c);
+			quads.push_back(d);
+		} else {
+			tris.push_back(a);
+			tris.push_back(b);
+			tris.push_back(c);
+			tris.push_back(a);
+			tris.push_back(c);
+			tris.push_back(d);
+		}
+	}
+};
+
+/**
+* Triangulates the strip between the outer edge of a side (only the vertices
+* the neighbour also has) and the row of vertices just inside it, walking
+* along both and always stepping whichever chain's next vertex comes first.
+* The strip starts and ends on the diagonals into the chunk's corners, so the
+* four sides fit together around the inside.
+*/
+void zip(const Lattice &lattice, const std::vector<ChainVertex> &outer, const std::vector<ChainVertex> &inner,
+		std::vector<unsigned short> &out) {
+	size_t a = 0, b = 0;
+	while (a + 1 < outer.size() || b + 1 < inner.size()) {
+		if (b + 1 == inner.size() || (a + 1 < outer.size() && outer[a+1].along <= inner[b+1].along)) {
+			lattice.triangle(out, outer[a].index, inner[b].index, outer[a+1].index);
+			a++;
+		} else {
+			lattice.triangle(out, outer[a].index, inner[b].index, inner[b+1].index);
+			b++;
+		}
+	}
+}
+
+}
+
+void buildChunkIndices(int nx, int nz, int level, const int border[4], bool quads,
+		std::vector<unsigned short> &triangles, std::vector<unsigned short> &quadIndices) {
+	triangles.clear();
+	quadIndices.clear();
+
+	Lattice lattice;
+	lattice.nx = nx;
+	lattice.nz = nz;
+	lattice.level = level;
+	lattice.vx = levelVertexCount(nx, level);
+	lattice.vz = levelVertexCount(nz, level);
+
+	bool stitched = false;
+	for (int side = 0; side < 4; side++) {
+		if (border[side] > level) stitched = true;
+	}
+
+	// nothing to stitch (or too small to have an inside), so it's just a grid
+	if (!stitched || lattice.vx < 3 || lattice.vz < 3) {
+		for (int i = 0; i < lattice.vx - 1; i++) {
+			for (int j = 0; j < lattice.vz - 1; j++) {
+				lattice.cell(triangles, quadIndices, quads, i, j);
+			}
+		}
+		return;
+	}
+
+	// the ring of cells around the edge, one side at a time
+	std::vector<ChainVertex> outer, inner;
+	for (int side = 0; side < 4; side++) {
+		bool alongZ = side == CHUNK_SIDE_X0 || side == CHUNK_SIDE_X1;
+		int count = alongZ ? lattice.vz : lattice.vx;
+		int length = alongZ ? nz : nx;
+		int edge = (side == CHUNK_SIDE_X0 || side == CHUNK_SIDE_Z0) ? 0 : (alongZ ? lattice.vx : lattice.vz) - 1;
+		int inside = edge == 0 ? 1 : edge - 1;
+		int step = 1 << std::max(border[side], level);
+
+		outer.clear();
+		inner.clear();
+		for (int k = 0; k < count; k++) {
+			ChainVertex v;
+			v.along = alongZ ? lattice.z(k) : lattice.x(k);
+			// the outer edge only has the vertices the neighbour has too
+			if (v.along % step == 0 || v.along == length) {
+				v.index = alongZ ? lattice.index(edge, k) : lattice.index(k, edge);
+				outer.push_back(v);
+			}
+			if (k > 0 && k < count - 1) {
+				v.index = alongZ ? lattice.index(inside, k) : lattice.index(k, inside);
+				inner.push_back(v);
+			}
+		}
+		zip(lattice, outer, inner, triangles);
+	}
+
+	// and the cells inside the ring
+	for (int i = 1; i < lattice.vx - 2; i++) {
+		for (int j = 1; j < lattice.vz - 2; j++) {
+			lattice.cell(triangles, quadIndices, quads, i, j);
+		}
+	}
+}
+
+/**
+* Compares every height in the chunk against the level's surface, which is
+* interpolated bilinearly between the level's vertices around it.
+*/
+void chunkLevelErrors(const float *heights, int stride, int nx, int nz, float errors[CHUNK_LEVELS]) {
+	errors[0] = 0;
+	for (int level = 1; level < CHUNK_LEVELS; level++) {
+		int step = 1 << level;
+		float error = errors[level-1];
+		for (int x = 0; x <= nx; x++) {
+			// the level's vertices either side of x
+			int xa = std::min(x / step * step, nx);
+			int xb = std::min(xa + step, nx);
+			float fx = xb > xa ? (float)(x - xa) / (xb - xa) : 0;
+			const float *rowA = heights + (size_t)xa * stride;
+			const float *rowB = heights + (size_t)xb * stride;
+			const float *row = heights + (size_t)x * stride;
+			for (int z = 0; z <= nz; z++) {
+				int za = std::min(z / step * step, nz);
+				int zb = std::min(za + step, nz);
+				float fz = zb > za ? (float)(z - za) / (zb - za) : 0;
+				float a = rowA[za] + (rowA[zb] - rowA[za]) * fz;
+				float b = rowB[za] + (rowB[zb] - rowB[za]) * fz;
+				float h = a + (b - a) * fx;
+				error = std::max(error, std::fabs(row[z] - h));
+			}
+		}
+		errors[level] = error;
+	}
+}
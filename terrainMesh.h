@@ -0,0 +1,79 @@
+#ifndef TERRAIN_MESH_H
+#define TERRAIN_MESH_H
+
+#include "terrainGenerator.h"
+#include "colorRamp.h"
+#include <vector>
+
+/**
+* One vertex of the terrain mesh, interleaved the way it's uploaded to GL.
+* There is one of these per grid point of a chunk, shared by every cell touching it.
+*/
+struct TerrainVertex {
+	float position[3];
+	float normal[3];
+	float texcoord[2];
+	unsigned char color[4];
+};
+
+/**
+* The terrain is drawn in chunks of CHUNK_SIZE x CHUNK_SIZE cells, each at its
+* own level of detail. The last chunk along each axis also takes whatever
+* cells are left over, so chunks are between CHUNK_SIZE and 2*CHUNK_SIZE-1
+* cells across (unless the whole terrain is smaller than that).
+*
+* Level l keeps every 2^l th vertex of the chunk, plus the vertex on the far
+* edge if the chunk isn't a multiple of 2^l. A chunk's edge at a coarser
+* level is always a subset of the same edge at a finer one, which is what
+* lets neighbouring chunks at different levels be stitched together.
+*/
+const int CHUNK_SIZE = 64;
+
+// number of levels of detail, level 0 is full resolution
+const int CHUNK_LEVELS = 6;
+
+// the sides of a chunk: the x0 and x1 edges (rows) and z0 and z1 edges (columns)
+enum ChunkSide {
+	CHUNK_SIDE_X0 = 0,
+	CHUNK_SIDE_X1,
+	CHUNK_SIDE_Z0,
+	CHUNK_SIDE_Z1
+};
+
+// number of chunks along an axis of the grid with the given number of cells
+int chunkCount(int cells);
+
+// first cell of chunk k along an axis
+int chunkStart(int k);
+
+// number of cells in chunk k along an axis with the given number of cells
+int chunkCells(int k, int cells);
+
+// number of vertices along a chunk edge n cells long at a level
+int levelVertexCount(int n, int level);
+
+// cell offset of vertex i along a chunk edge n cells long at a level
+int levelVertexPosition(int i, int n, int level);
+
+// the coarsest level a chunk of nx by nz cells has, so every level keeps at least 3 vertices a side
+int chunkMaxLevel(int nx, int nz);
+
+// fills out with the vertices of the chunk of nx by nz cells starting at (x0, z0) at a level,
+// row-major like the grids. heights and normals hold the chunk's (nx+1) by (nz+1) points,
+// starting at (x0, z0) with rows stride apart. texture coordinates are the grid coordinates.
+void assembleChunkVertices(const float *heights, const Vec3D *normals, int stride, float max_height,
+	const ColorRamp &ramp, int x0, int z0, int nx, int nz, int level, TerrainVertex *out);
+
+// indices (into the chunk's vertices at level) of a chunk whose sides have to meet
+// neighbours at border[side] levels (at least level). everything is wound counter-clockwise
+// seen from above. cells along sides that meet a coarser neighbour are triangles fanned
+// onto the coarser edge, the rest are quads if quads is set, otherwise triangles.
+void buildChunkIndices(int nx, int nz, int level, const int border[4], bool quads,
+	std::vector<unsigned short> &triangles, std::vector<unsigned short> &quadIndices);
+
+// the geometric error of each level of a chunk of nx by nz cells: how far any height in it
+// is from the surface drawn at that level. heights are laid out as for assembleChunkVertices.
+// errors never go down as the level goes up.
+void chunkLevelErrors(const float *heights, int stride, int nx, int nz, float errors[CHUNK_LEVELS]);
+
+#endif
@@ -0,0 +1,122 @@
+#include "terrainQuadtree.h"
+#include <algorithm>
+
+TerrainQuadtree::TerrainQuadtree() {
+	this->chunksZ = 0;
+}
+
+void TerrainQuadtree::build(int chunksX, int chunksZ) {
+	this->nodes.clear();
+	this->chunksZ = chunksZ;
+	this->leaves.assign(chunksX * chunksZ, -1);
+	if (chunksX <= 0 || chunksZ <= 0) return;
+	this->nodes.push_back(makeNode(-1, 0, 0, chunksX, chunksZ));
+	this->split(0);
+}
+
+TerrainQuadtree::Node TerrainQuadtree::makeNode(int parent, int cx0, int cz0, int cx1, int cz1) {
+	Node node;
+	node.cx0 = cx0;
+	node.cz0 = cz0;
+	node.cx1 = cx1;
+	node.cz1 = cz1;
+	node.x0 = node.z0 = node.x1 = node.z1 = 0;
+	node.minHeight = node.maxHeight = 0;
+	node.parent = parent;
+	node.firstChild = -1;
+	node.childCount = 0;
+	node.chunk = -1;
+	return node;
+}
+
+/**
+* Splits the range in half along each axis that's more than one chunk wide,
+* so a node has 4 children (or 2 at the edge of a grid that isn't square).
+* A node's children are stored next to each other.
+*/
+void TerrainQuadtree::split(int index) {
+	// copied, the vector can move while children are added
+	Node node = this->nodes[index];
+	if (node.cx1 - node.cx0 == 1 && node.cz1 - node.cz0 == 1) {
+		this->nodes[index].chunk = node.cx0 * this->chunksZ + node.cz0;
+		this->leaves[this->nodes[index].chunk] = index;
+		return;
+	}
+
+	int xs[3] = {node.cx0, (node.cx0 + node.cx1) / 2, node.cx1};
+	int zs[3] = {node.cz0, (node.cz0 + node.cz1) / 2, node.cz1};
+	int xCount = node.cx1 - node.cx0 > 1 ? 2 : 1;
+	int zCount = node.cz1 - node.cz0 > 1 ? 2 : 1;
+	if (xCount == 1) xs[1] = node.cx1;
+	if (zCount == 1) zs[1] = node.cz1;
+
+	int first = this->nodes.size();
+	for (int i = 0; i < xCount; i++) {
+		for (int j = 0; j < zCount; j++) {
+			this->nodes.push_back(makeNode(index, xs[i], zs[j], xs[i+1], zs[j+1]));
+		}
+	}
+	this->nodes[index].firstChild = first;
+	this->nodes[index].childCount = xCount * zCount;
+	for (int k = 0; k < xCount * zCount; k++) this->split(first + k);
+}
+
+void TerrainQuadtree::setLeaf(int chunk, float x0, float z0, float x1, float z1, float minHeight, float maxHeight) {
+	Node &leaf = this->nodes[this->leaves[chunk]];
+	leaf.x0 = x0;
+	leaf.z0 = z0;
+	leaf.x1 = x1;
+	leaf.z1 = z1;
+	this->updateLeaf(chunk, minHeight, maxHeight);
+}
+
+void TerrainQuadtree::updateLeaf(int chunk, float minHeight, float maxHeight) {
+	int node = this->leaves[chunk];
+	this->nodes[node].minHeight = minHeight;
+	this->nodes[node].maxHeight = maxHeight;
+	for (node = this->nodes[node].parent; node >= 0; node = this->nodes[node].parent) this->refit(node);
+}
+
+void TerrainQuadtree::refit(int index) {
+	Node &node = this->nodes[index];
+	const Node &first = this->nodes[node.firstChild];
+	node.x0 = first.x0;
+	node.z0 = first.z0;
+	node.x1 = first.x1;
+	node.z1 = first.z1;
+	node.minHeight = first.minHeight;
+	node.maxHeight = first.maxHeight;
+	for (int i = 1; i < node.childCount; i++) {
+		const Node &child = this->nodes[node.firstChild + i];
+		node.x0 = std::min(node.x0, child.x0);
+		node.z0 = std::min(node.z0, child.z0);
+		node.x1 = std::max(node.x1, child.x1);
+		node.z1 = std::max(node.z1, child.z1);
+		node.minHeight = std::min(node.minHeight, child.minHeight);
+		node.maxHeight = std::max(node.maxHeight, child.maxHeight);
+	}
+}
+
+int TerrainQuadtree::cull(const Frustum &frustum, std::vector<int> &visible) const {
+	visible.clear();
+	int count = 0;
+	if (!this->nodes.empty()) this->cullNode(0, frustum, false, visible, count);
+	return count;
+}
+
+void TerrainQuadtree::cullNode(int index, const Frustum &frustum, bool inside, std::vector<int> &visible, int &count) const {
+	const Node &node = this->nodes[index];
+	if (!inside) {
+		Frustum::Test test = frustum.testBox(node.x0, node.minHeight, node.z0, node.x1, node.maxHeight, node.z1);
+		if (test == Frustum::OUTSIDE) return;
+		inside = test == Frustum::INSIDE;
+	}
+	count++;
+	if (node.chunk >= 0) {
+		visible.push_back(node.chunk);
+		return;
+	}
+	for (int i = 0; i < node.childCount; i++) {
+		this->cullNode(node.firstChild + i, frustum, inside, visible, count);
+	}
+}
@@ -0,0 +1,67 @@
+#ifndef TERRAIN_QUADTREE_H
+#define TERRAIN_QUADTREE_H
+
+#include "frustum.h"
+#include <vector>
+
+/**
+* A quadtree over the terrain's chunks. Every node knows the cells it covers
+* and the lowest and highest heights under it, which gives it a bounding box
+* to cull against the view frustum: if a node is outside nothing under it
+* needs looking at, and if it's completely inside nothing under it needs testing.
+*/
+class TerrainQuadtree {
+public:
+	TerrainQuadtree();
+
+	// builds the tree over a chunksX by chunksZ grid of chunks. the leaves have no height range yet.
+	void build(int chunksX, int chunksZ);
+
+	// sets the area (cells [x0, x1) by [z0, z1)) and height range of a chunk,
+	// and widens its ancestors to fit
+	void setLeaf(int chunk, float x0, float z0, float x1, float z1, float minHeight, float maxHeight);
+
+	// changes the height range of a chunk, recomputing the ranges of its ancestors
+	void updateLeaf(int chunk, float minHeight, float maxHeight);
+
+	// fills visible with the index of every chunk whose box is at least partly inside
+	// the frustum. returns the number of nodes that were visible.
+	int cull(const Frustum &frustum, std::vector<int> &visible) const;
+
+	// total number of nodes in the tree
+	int nodeCount() const { return this->nodes.size(); }
+
+private:
+	struct Node {
+		// the chunks it covers
+		int cx0, cz0, cx1, cz1;
+		// its bounding box
+		float x0, z0, x1, z1;
+		float minHeight, maxHeight;
+		int parent;
+		// index of the first child (they're stored together) and how many there are
+		int firstChild;
+		int childCount;
+		// the chunk, for leaves
+		int chunk;
+	};
+
+	// a node covering chunks [cx0, cx1) x [cz0, cz1), with no children yet
+	static Node makeNode(int parent, int cx0, int cz0, int cx1, int cz1);
+
+	// adds a node's children (and theirs), down to one chunk per leaf
+	void split(int node);
+
+	// recomputes a node's box from its children
+	void refit(int node);
+
+	// adds the chunks of a node to visible, testing its children if it's only partly in view
+	void cullNode(int node, const Frustum &frustum, bool inside, std::vector<int> &visible, int &count) const;
+
+	int chunksZ;
+	std::vector<Node> nodes;
+	// the leaf node of each chunk
+	std::vector<int> leaves;
+};
+
+#endif
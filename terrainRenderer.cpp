@@ -0,0 +1,263 @@
+#include "glExtensions.h"
+#include "terrainRenderer.h"
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+
+// offset of a member of TerrainVertex, as the pointer GL expects for buffer offsets
+#define VERTEX_OFFSET(member) (reinterpret_cast<const GLvoid*>(offsetof(TerrainVertex, member)))
+
+TerrainRenderer::TerrainRenderer() {
+	this->pixelError = 2.0;
+	this->trianglesDrawn = 0;
+	this->x_size = 0;
+	this->z_size = 0;
+	this->chunksX = 0;
+	this->chunksZ = 0;
+	this->visibleNodes = 0;
+	this->frame = 0;
+}
+
+TerrainRenderer::~TerrainRenderer() {
+	this->release();
+}
+
+/**
+* Frees the GL buffers. Needs the context to still be current.
+*/
+void TerrainRenderer::release() {
+	for (size_t i = 0; i < this->chunks.size(); i++) {
+		if (this->chunks[i].buffer) glDeleteBuffers(1, &this->chunks[i].buffer);
+	}
+	this->chunks.clear();
+	this->visible.clear();
+	this->quadtree.build(0, 0);
+	for (std::map<unsigned long long, IndexSet>::iterator it = this->indexSets.begin(); it != this->indexSets.end(); ++it) {
+		glDeleteBuffers(1, &it->second.buffer);
+	}
+	this->indexSets.clear();
+	this->x_size = 0;
+	this->z_size = 0;
+	this->chunksX = 0;
+	this->chunksZ = 0;
+}
+
+/**
+* A new terrain: the chunks' level errors come from its final heights, so
+* they only need working out once per terrain rather than as it rises.
+* The terrain is read a chunk at a time, so a source that pages its data in
+* only ever needs a chunk's worth of it at once.
+*/
+void TerrainRenderer::update(TerrainSource &terrain) {
+	if (terrain.xSize() != this->x_size || terrain.zSize() != this->z_size) {
+		this->release();
+		this->x_size = terrain.xSize();
+		this->z_size = terrain.zSize();
+		// chunks are made of cells, there's one less of those than grid points
+		this->chunksX = chunkCount(this->x_size - 1);
+		this->chunksZ = chunkCount(this->z_size - 1);
+		this->chunks.resize(this->chunksX * this->chunksZ);
+		for (int cx = 0; cx < this->chunksX; cx++) {
+			for (int cz = 0; cz < this->chunksZ; cz++) {
+				Chunk &c = this->chunk(cx, cz);
+				c.x0 = chunkStart(cx);
+				c.z0 = chunkStart(cz);
+				c.nx = chunkCells(cx, this->x_size - 1);
+				c.nz = chunkCells(cz, this->z_size - 1);
+				c.maxLevel = chunkMaxLevel(c.nx, c.nz);
+				c.level = 0;
+				c.buffer = 0;
+				c.lastSeen = 0;
+			}
+		}
+		this->quadtree.build(this->chunksX, this->chunksZ);
+	}
+
+	this->visible.clear();
+	for (size_t i = 0; i < this->chunks.size(); i++) {
+		Chunk &c = this->chunks[i];
+		this->heights.resize((c.nx + 1) * (c.nz + 1));
+		terrain.readFinalHeights(c.x0, c.z0, c.x0 + c.nx + 1, c.z0 + c.nz + 1, &this->heights[0]);
+		chunkLevelErrors(&this->heights[0], c.nz + 1, c.nx, c.nz, c.errors);
+		this->measure(terrain, c);
+		this->quadtree.setLeaf(i, c.x0, c.z0, c.x0 + c.nx, c.z0 + c.nz, c.minHeight, c.maxHeight);
+		c.uploadedLevel = -1;
+		this->visible.push_back(i);
+	}
+}
+
+void TerrainRenderer::measure(TerrainSource &terrain, Chunk &c) {
+	this->heights.resize((c.nx + 1) * (c.nz + 1));
+	terrain.readHeights(c.x0, c.z0, c.x0 + c.nx + 1, c.z0 + c.nz + 1, &this->heights[0]);
+	std::pair<std::vector<float>::iterator, std::vector<float>::iterator> range =
+		std::minmax_element(this->heights.begin(), this->heights.end());
+	c.minHeight = *range.first;
+	c.maxHeight = *range.second;
+}
+
+void TerrainRenderer::update(TerrainSource &terrain, int firstRow, int rowCount) {
+	if (terrain.xSize() != this->x_size || terrain.zSize() != this->z_size) {
+		this->update(terrain);
+		return;
+	}
+	int lastRow = firstRow + rowCount - 1;
+	for (size_t i = 0; i < this->chunks.size(); i++) {
+		Chunk &c = this->chunks[i];
+		// chunks share their edge rows with the next chunk
+		if (c.x0 <= lastRow && c.x0 + c.nx >= firstRow) {
+			this->measure(terrain, c);
+			this->quadtree.updateLeaf(i, c.minHeight, c.maxHeight);
+			c.uploadedLevel = -1;
+		}
+	}
+}
+
+void TerrainRenderer::cull(const Frustum &frustum) {
+	this->visibleNodes = this->quadtree.cull(frustum, this->visible);
+}
+
+/**
+* Uses the coarsest level whose error, seen from the closest point of the
+* chunk's bounding box, stays under pixelError pixels. Every chunk gets a
+* level (the visible ones need to know their neighbours'), but only visible
+* chunks are rebuilt, and chunks that haven't been seen for a while give
+* their buffers up, so only what's around the view stays uploaded.
+*/
+void TerrainRenderer::selectLevels(TerrainSource &terrain, const Vec3D &eye, float fovY, int screenHeight) {
+	this->trianglesDrawn = 0;
+	this->frame++;
+	// pixels per unit of error at a distance of 1
+	float scale = screenHeight / (2 * tanf(fovY * 3.14159265f / 360));
+
+	for (size_t i = 0; i < this->chunks.size(); i++) {
+		Chunk &c = this->chunks[i];
+
+		float dx = std::max(std::max(c.x0 - eye.mX, eye.mX - (c.x0 + c.nx)), 0.0f);
+		float dy = std::max(std::max(c.minHeight - eye.mY, eye.mY - c.maxHeight), 0.0f);
+		float dz = std::max(std::max(c.z0 - eye.mZ, eye.mZ - (c.z0 + c.nz)), 0.0f);
+		float distance = sqrtf(dx*dx + dy*dy + dz*dz);
+
+		c.level = 0;
+		while (c.level < c.maxLevel && c.errors[c.level + 1] * scale <= this->pixelError * distance) c.level++;
+
+		if (c.buffer && this->frame - c.lastSeen > BUFFER_IDLE_FRAMES) {
+			glDeleteBuffers(1, &c.buffer);
+			c.buffer = 0;
+			c.uploadedLevel = -1;
+		}
+	}
+
+	for (size_t i = 0; i < this->visible.size(); i++) {
+		Chunk &c = this->chunks[this->visible[i]];
+		c.lastSeen = this->frame;
+		if (c.level != c.uploadedLevel) {
+			int points = (c.nx + 1) * (c.nz + 1);
+			this->heights.resize(points);
+			this->normals.resize(points);
+			terrain.readHeights(c.x0, c.z0, c.x0 + c.nx + 1, c.z0 + c.nz + 1, &this->heights[0]);
+			terrain.readNormals(c.x0, c.z0, c.x0 + c.nx + 1, c.z0 + c.nz + 1, &this->normals[0]);
+
+			int count = levelVertexCount(c.nx, c.level) * levelVertexCount(c.nz, c.level);
+			this->vertices.resize(count);
+			assembleChunkVertices(&this->heights[0], &this->normals[0], c.nz + 1, terrain.maxHeight(), this->ramp,
+				c.x0, c.z0, c.nx, c.nz, c.level, &this->vertices[0]);
+			if (!c.buffer) glGenBuffers(1, &c.buffer);
+			glBindBuffer(GL_ARRAY_BUFFER, c.buffer);
+			glBufferData(GL_ARRAY_BUFFER, count * sizeof(TerrainVertex), &this->vertices[0], GL_DYNAMIC_DRAW);
+			c.uploadedLevel = c.level;
+		}
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/**
+* Index buffers are cached by everything that goes into them, which only
+* comes to a handful of combinations in practice.
+*/
+const TerrainRenderer::IndexSet &TerrainRenderer::indices(const Chunk &c, int cx, int cz, bool quads) {
+	// a side meets its neighbour at whichever of them is coarser
+	int border[4] = {c.level, c.level, c.level, c.level};
+	if (cx > 0) border[CHUNK_SIDE_X0] = std::max(c.level, this->chunk(cx - 1, cz).level);
+	if (cx < this->chunksX - 1) border[CHUNK_SIDE_X1] = std::max(c.level, this->chunk(cx + 1, cz).level);
+	if (cz > 0) border[CHUNK_SIDE_Z0] = std::max(c.level, this->chunk(cx, cz - 1).level);
+	if (cz < this->chunksZ - 1) border[CHUNK_SIDE_Z1] = std::max(c.level, this->chunk(cx, cz + 1).level);
+
+	unsigned long long key = ((unsigned long long)c.nx << 32) | ((unsigned long long)c.nz << 24) |
+		(c.level << 16) | (border[0] << 12) | (border[1] << 8) | (border[2] << 4) | (border[3] << 1) | (quads ? 1 : 0);
+	std::map<unsigned long long, IndexSet>::iterator it = this->indexSets.find(key);
+	if (it != this->indexSets.end()) return it->second;
+
+	buildChunkIndices(c.nx, c.nz, c.level, border, quads, this->triangleIndices, this->quadIndices);
+	IndexSet set;
+	set.triangleCount = this->triangleIndices.size();
+	set.quadCount = this->quadIndices.size();
+	this->triangleIndices.insert(this->triangleIndices.end(), this->quadIndices.begin(), this->quadIndices.end());
+	glGenBuffers(1, &set.buffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, set.buffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->triangleIndices.size() * sizeof(unsigned short),
+		this->triangleIndices.empty() ? NULL : &this->triangleIndices[0], GL_STATIC_DRAW);
+	return this->indexSets[key] = set;
+}
+
+/**
+* Draws every visible chunk, one or two calls each.
+*/
+void TerrainRenderer::draw(bool triangles, bool wire) {
+	if (this->chunks.empty()) return;
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+
+	// filled terrain is colored per vertex. with lighting on, the color drives the material.
+	if (!wire) {
+		glEnableClientState(GL_COLOR_ARRAY);
+		glColorMaterial(GL_FRONT, GL_AMBIENT_AND_DIFFUSE);
+		glEnable(GL_COLOR_MATERIAL);
+	}
+
+	// LoadPPM gives images top row first, where the original loader gave them back to front
+	// (turned half way round), so the texture coordinates are turned half way round to show
+	// them as they always were. the quads were also textured upside down relative to the
+	// triangles, keep it that way
+	glMatrixMode(GL_TEXTURE);
+	glPushMatrix();
+	if (triangles) glScalef(-1, -1, 1);
+	else glScalef(-1, 1, 1);
+	glMatrixMode(GL_MODELVIEW);
+
+	for (size_t i = 0; i < this->visible.size(); i++) {
+		int cx = this->visible[i] / this->chunksZ;
+		int cz = this->visible[i] % this->chunksZ;
+		Chunk &c = this->chunk(cx, cz);
+		if (c.uploadedLevel != c.level) continue;
+		const IndexSet &set = this->indices(c, cx, cz, !triangles);
+
+		glBindBuffer(GL_ARRAY_BUFFER, c.buffer);
+		glVertexPointer(3, GL_FLOAT, sizeof(TerrainVertex), VERTEX_OFFSET(position));
+		glNormalPointer(GL_FLOAT, sizeof(TerrainVertex), VERTEX_OFFSET(normal));
+		glTexCoordPointer(2, GL_FLOAT, sizeof(TerrainVertex), VERTEX_OFFSET(texcoord));
+		if (!wire) glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(TerrainVertex), VERTEX_OFFSET(color));
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, set.buffer);
+		if (set.triangleCount) glDrawElements(GL_TRIANGLES, set.triangleCount, GL_UNSIGNED_SHORT, 0);
+		if (set.quadCount) {
+			glDrawElements(GL_QUADS, set.quadCount, GL_UNSIGNED_SHORT,
+				reinterpret_cast<const GLvoid*>(set.triangleCount * sizeof(unsigned short)));
+		}
+		this->trianglesDrawn += set.triangleCount / 3 + set.quadCount / 2;
+	}
+
+	glMatrixMode(GL_TEXTURE);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	if (!wire) {
+		glDisable(GL_COLOR_MATERIAL);
+		glDisableClientState(GL_COLOR_ARRAY);
+	}
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
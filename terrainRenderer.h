@@ -0,0 +1,137 @@
+#ifndef TERRAIN_RENDERER_H
+#define TERRAIN_RENDERER_H
+
+#include "glExtensions.h"
+#include "terrainSource.h"
+#include "terrainMesh.h"
+#include "terrainQuadtree.h"
+#include "frustum.h"
+#include <vector>
+#include <map>
+
+/**
+* Draws a terrain in chunks (see terrainMesh.h), each at a level of detail
+* picked every frame from how big its geometric error would be on screen.
+*
+* Each chunk has its own vertex buffer holding just the vertices of its
+* current level, which is only rebuilt when the level or the heights under
+* it change. Chunks of the same size at the same level meeting the same
+* neighbour levels share an index buffer, and sides that meet a coarser
+* neighbour are stitched onto its edge so there are no cracks.
+*
+* Chunks outside the view frustum are culled with a quadtree of their
+* bounding boxes, and are neither rebuilt nor drawn.
+*
+* The terrain is only ever read a chunk at a time through a TerrainSource,
+* so it can be streamed from a tile store instead of being held in memory.
+*/
+class TerrainRenderer {
+public:
+	TerrainRenderer();
+	~TerrainRenderer();
+
+	// lays out the chunks for the terrain (if its size changed), works out the
+	// error of every level and marks every chunk to be rebuilt
+	void update(TerrainSource &terrain);
+
+	// marks the chunks covering rows [firstRow, firstRow+rowCount) to be rebuilt
+	// and updates their bounding boxes
+	void update(TerrainSource &terrain, int firstRow, int rowCount);
+
+	// finds the chunks that are at least partly inside the frustum, only those are drawn.
+	// until this is called every chunk is.
+	void cull(const Frustum &frustum);
+
+	// picks the level of every chunk for a camera at eye with a vertical field of
+	// view of fovY degrees on a screen screenHeight pixels tall, then uploads the
+	// visible chunks that changed. resets trianglesDrawn.
+	void selectLevels(TerrainSource &terrain, const Vec3D &eye, float fovY, int screenHeight);
+
+	// draws the terrain with quads (or triangles if triangles is set).
+	// wire draws without the vertex colors, so the current color/material is used.
+	void draw(bool triangles, bool wire);
+
+	// frees the GL buffers
+	void release();
+
+	// colors the filled terrain by height. the colors are baked into the
+	// vertices, so call update() after changing it.
+	ColorRamp ramp;
+
+	// how far (in pixels) a chunk's surface is allowed to be from the full
+	// resolution surface on screen. 0 draws everything at full resolution.
+	float pixelError;
+
+	// triangles submitted by draw() since the last selectLevels(), a quad counts as 2
+	long trianglesDrawn;
+
+	// quadtree nodes found visible by the last cull(), and how many there are in total
+	int visibleNodes;
+	int nodeCount() const { return this->quadtree.nodeCount(); }
+
+private:
+	// the renderer owns GL buffers, so it can't be copied
+	TerrainRenderer(const TerrainRenderer &other);
+	TerrainRenderer &operator=(const TerrainRenderer &other);
+
+	// a chunk that hasn't been visible for this many frames frees its vertex buffer
+	static const int BUFFER_IDLE_FRAMES = 120;
+
+	struct Chunk {
+		// the cells it covers
+		int x0, z0;
+		int nx, nz;
+		int maxLevel;
+		// geometric error of each level, from the final heights
+		float errors[CHUNK_LEVELS];
+		// range of its current heights
+		float minHeight, maxHeight;
+		// the level it's drawn at, and the level its buffer holds (-1 if it needs rebuilding)
+		int level;
+		int uploadedLevel;
+		GLuint buffer;
+		// the last frame it was visible in
+		long lastSeen;
+	};
+
+	// one shared index buffer: triangles followed by quads
+	struct IndexSet {
+		GLuint buffer;
+		GLsizei triangleCount;
+		GLsizei quadCount;
+	};
+
+	// the index buffer for a chunk at its current level against its neighbours
+	const IndexSet &indices(const Chunk &chunk, int cx, int cz, bool quads);
+
+	// the chunk at (cx, cz), which has to be in range
+	Chunk &chunk(int cx, int cz) { return this->chunks[cx * this->chunksZ + cz]; }
+
+	// finds the range of the current heights of a chunk
+	void measure(TerrainSource &terrain, Chunk &chunk);
+
+	// size of the grid the chunks were laid out for
+	int x_size;
+	int z_size;
+	int chunksX;
+	int chunksZ;
+	std::vector<Chunk> chunks;
+
+	TerrainQuadtree quadtree;
+	// indices of the chunks that passed the last cull
+	std::vector<int> visible;
+
+	std::map<unsigned long long, IndexSet> indexSets;
+
+	// number of selectLevels() calls so far
+	long frame;
+
+	// reused when building chunks
+	std::vector<float> heights;
+	std::vector<Vec3D> normals;
+	std::vector<TerrainVertex> vertices;
+	std::vector<unsigned short> triangleIndices;
+	std::vector<unsigned short> quadIndices;
+};
+
+#endif
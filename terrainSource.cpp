@@ -0,0 +1,57 @@
+#include "terrainSource.h"
+#include "normalKernel.h"
+#include <algorithm>
+
+// copies rows [x0, x1) and columns [z0, z1) of a grid into out, row by row
+template <typename T>
+static void copyRect(const Grid<T> &grid, int x0, int z0, int x1, int z1, T *out) {
+	for (int x = x0; x < x1; x++) {
+		std::copy(grid.row(x) + z0, grid.row(x) + z1, out);
+		out += z1 - z0;
+	}
+}
+
+StateSource::StateSource(const TerrainState &state) : state(state) {}
+
+void StateSource::readHeights(int x0, int z0, int x1, int z1, float *out) {
+	copyRect(this->state.currentheight, x0, z0, x1, z1, out);
+}
+
+void StateSource::readFinalHeights(int x0, int z0, int x1, int z1, float *out) {
+	copyRect(this->state.heightmap, x0, z0, x1, z1, out);
+}
+
+void StateSource::readNormals(int x0, int z0, int x1, int z1, Vec3D *out) {
+	copyRect(this->state.normals, x0, z0, x1, z1, out);
+}
+
+StoreSource::StoreSource(TileStore &store) : store(store) {}
+
+void StoreSource::readHeights(int x0, int z0, int x1, int z1, float *out) {
+	this->store.read(x0, z0, x1, z1, out);
+}
+
+void StoreSource::readFinalHeights(int x0, int z0, int x1, int z1, float *out) {
+	this->store.read(x0, z0, x1, z1, out);
+}
+
+/**
+* A normal depends on the heights next to it, so the rectangle is read with
+* an extra cell on each side that isn't the edge of the grid. The normals of
+* that border are thrown away; at the grid's edges there's no border, and the
+* kernel treats them as edges just like it does for the whole grid.
+*/
+void StoreSource::readNormals(int x0, int z0, int x1, int z1, Vec3D *out) {
+	if (x1 <= x0 || z1 <= z0) return;
+	int bx0 = std::max(x0 - 1, 0);
+	int bz0 = std::max(z0 - 1, 0);
+	int bx1 = std::min(x1 + 1, this->store.x_size);
+	int bz1 = std::min(z1 + 1, this->store.z_size);
+
+	this->border.resize(bx1 - bx0, bz1 - bz0);
+	this->store.read(bx0, bz0, bx1, bz1, this->border.data());
+	this->borderNormals.resize(bx1 - bx0, bz1 - bz0);
+	computeVertexNormals(this->border, this->borderNormals);
+
+	copyRect(this->borderNormals, x0 - bx0, z0 - bz0, x1 - bx0, z1 - bz0, out);
+}
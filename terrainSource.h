@@ -0,0 +1,86 @@
+#ifndef TERRAIN_SOURCE_H
+#define TERRAIN_SOURCE_H
+
+#include "terrainGenerator.h"
+#include "tileStore.h"
+#include "mathLib3D.h"
+#include "grid.h"
+
+/**
+* Where the renderer reads a terrain from. Everything is read a rectangle at
+* a time, so a source only ever needs the part being read to be in memory:
+* a TerrainState has all of it already, a TileStore pages in just the tiles
+* under the rectangle.
+*/
+class TerrainSource {
+public:
+	virtual ~TerrainSource() {}
+
+	// size of the grid x, z
+	virtual int xSize() const = 0;
+	virtual int zSize() const = 0;
+
+	// maximum height in the heightmap
+	virtual float maxHeight() const = 0;
+
+	// copies the current heights of rows [x0, x1) and columns [z0, z1) into out, row by row
+	virtual void readHeights(int x0, int z0, int x1, int z1, float *out) = 0;
+
+	// the same for the heights the terrain will end up at, which can be different
+	// while it's still rising
+	virtual void readFinalHeights(int x0, int z0, int x1, int z1, float *out) = 0;
+
+	// the vertex normals of the same rectangle
+	virtual void readNormals(int x0, int z0, int x1, int z1, Vec3D *out) = 0;
+};
+
+/**
+* A terrain held in memory, generated and animated by the viewer.
+*/
+class StateSource : public TerrainSource {
+public:
+	StateSource(const TerrainState &state);
+
+	int xSize() const { return this->state.x_size; }
+	int zSize() const { return this->state.z_size; }
+	float maxHeight() const { return this->state.max_height; }
+
+	void readHeights(int x0, int z0, int x1, int z1, float *out);
+	void readFinalHeights(int x0, int z0, int x1, int z1, float *out);
+	void readNormals(int x0, int z0, int x1, int z1, Vec3D *out);
+
+private:
+	const TerrainState &state;
+};
+
+/**
+* A terrain in a tile store. It doesn't animate, so the current heights are
+* the final ones, and there are no stored normals: they're computed from the
+* heights read with a one cell border, which gives the same normals as
+* computing them over the whole grid.
+*/
+class StoreSource : public TerrainSource {
+public:
+	StoreSource(TileStore &store);
+
+	int xSize() const { return this->store.x_size; }
+	int zSize() const { return this->store.z_size; }
+	float maxHeight() const { return this->store.max_height; }
+
+	void readHeights(int x0, int z0, int x1, int z1, float *out);
+	void readFinalHeights(int x0, int z0, int x1, int z1, float *out);
+	void readNormals(int x0, int z0, int x1, int z1, Vec3D *out);
+
+private:
+	// the source keeps the store's tiles moving through its budget, so it can't be copied
+	StoreSource(const StoreSource &other);
+	StoreSource &operator=(const StoreSource &other);
+
+	TileStore &store;
+
+	// the heights around the rectangle being read and their normals, reused between reads
+	Grid<float> border;
+	Grid<Vec3D> borderNormals;
+};
+
+#endif
@@ -0,0 +1,86 @@
+#ifdef __APPLE__
+  #include <OpenGL/gl.h>
+  #include <OpenGL/glu.h>
+  #include <GLUT/glut.h>
+#else
+  #include <GL/gl.h>
+  #include <GL/glu.h>
+  #include <GL/freeglut.h>
+#endif
+
+#include "textureManager.h"
+
+TextureManager::TextureManager() {}
+
+TextureManager::~TextureManager() {
+	this->release();
+}
+
+/**
+* Uploads an image into a new slot.
+*/
+int TextureManager::add(const GLubyte *pixels, int width, int height) {
+	int slot = this->count();
+	this->reserve(slot + 1);
+	this->upload(slot, pixels, width, height);
+	return slot;
+}
+
+void TextureManager::reserve(int count) {
+	while (this->count() < count) this->textures.push_back(0);
+}
+
+/**
+* Uploads an image into a new texture object and builds its mipmaps.
+* gluBuild2DMipmaps also takes care of images that aren't a power of two.
+* Whatever texture was bound before stays bound.
+*/
+void TextureManager::upload(int slot, const GLubyte *pixels, int width, int height) {
+	this->reserve(slot + 1);
+	if (!this->textures[slot]) glGenTextures(1, &this->textures[slot]);
+	glPushAttrib(GL_TEXTURE_BIT);
+	glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+	glBindTexture(GL_TEXTURE_2D, this->textures[slot]);
+
+	// rows of RGB pixels are tightly packed
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	gluBuild2DMipmaps(GL_TEXTURE_2D, GL_RGB, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+
+	glPopClientAttrib();
+	glPopAttrib();
+}
+
+bool TextureManager::loaded(int slot) {
+	return slot >= 0 && slot < this->count() && this->textures[slot] != 0;
+}
+
+/**
+* Binds a texture, no uploading happens here.
+*/
+bool TextureManager::bind(int slot) {
+	if (this->loaded(slot)) {
+		glBindTexture(GL_TEXTURE_2D, this->textures[slot]);
+		return true;
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return false;
+}
+
+int TextureManager::count() {
+	return this->textures.size();
+}
+
+/**
+* Deletes the texture objects. Needs the context to still be current.
+*/
+void TextureManager::release() {
+	for (size_t i = 0; i < this->textures.size(); i++) {
+		if (this->textures[i]) glDeleteTextures(1, &this->textures[i]);
+	}
+	this->textures.clear();
+}
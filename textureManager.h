@@ -0,0 +1,57 @@
+#ifdef __APPLE__
+  #include <OpenGL/gl.h>
+  #include <OpenGL/glu.h>
+  #include <GLUT/glut.h>
+#else
+  #include <GL/gl.h>
+  #include <GL/glu.h>
+  #include <GL/freeglut.h>
+#endif
+
+#ifndef TEXTURE_MANAGER_H
+#define TEXTURE_MANAGER_H
+
+#include <vector>
+
+/**
+* Owns the GL texture objects for the terrain textures.
+* Each image is uploaded once (with a full mipmap chain) when it's added,
+* after that switching textures is just a bind.
+* Slots can be reserved up front and filled in any order as images arrive.
+*/
+class TextureManager {
+public:
+	TextureManager();
+	~TextureManager();
+
+	// creates a mipmapped texture from RGB pixels, returns the slot it was put in
+	int add(const GLubyte *pixels, int width, int height);
+
+	// makes sure there are at least count slots, new ones start out empty
+	void reserve(int count);
+
+	// creates a mipmapped texture from RGB pixels in a slot
+	void upload(int slot, const GLubyte *pixels, int width, int height);
+
+	// whether a slot has a texture in it
+	bool loaded(int slot);
+
+	// binds the texture in a slot. unbinds and returns false if the slot is
+	// out of range (e.g. -1) or empty, so drawing continues untextured.
+	bool bind(int slot);
+
+	// number of textures that have been added
+	int count();
+
+	// deletes all of the textures
+	void release();
+
+private:
+	// the manager owns GL textures, so it can't be copied
+	TextureManager(const TextureManager &other);
+	TextureManager &operator=(const TextureManager &other);
+
+	std::vector<GLuint> textures;
+};
+
+#endif
@@ -0,0 +1,412 @@
+#include "tileStore.h"
+#include <cstring>
+#include <cstdlib>
+#include <cfloat>
+#include <algorithm>
+#include <new>
+
+#ifdef _WIN32
+#  define TILE_STORE_NO_MMAP
+#else
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+namespace {
+
+// the header has the first page to itself, so every tile starts on a page
+const size_t HEADER_BYTES = 4096;
+const size_t TILE_BYTES = TileStore::TILE_SIZE * TileStore::TILE_SIZE * sizeof(float);
+
+// until setBudget() says otherwise
+const size_t DEFAULT_BUDGET = 256 * 1024 * 1024;
+
+// the start of the file. everything is stored in the machine's own byte order.
+struct Header {
+	char magic[4];
+	int x_size;
+	int z_size;
+	int tile_size;
+	float max_height;
+	unsigned int seed;
+};
+
+const char MAGIC[4] = {'T', 'H', 'M', '1'};
+
+// size of the file for a grid of tilesX by tilesZ tiles
+size_t fileSizeFor(int tilesX, int tilesZ) {
+	return HEADER_BYTES + (size_t)tilesX * tilesZ * TILE_BYTES;
+}
+
+// checks a header read from a file of the given size, returns a description of what's wrong or NULL
+const char *checkHeader(const Header &header, size_t size) {
+	if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) return "not a tiled heightmap";
+	if (header.tile_size != TileStore::TILE_SIZE) return "unsupported tile size";
+	if (header.x_size < 1 || header.z_size < 1) return "invalid grid size";
+	int tilesX = (header.x_size + TileStore::TILE_SIZE - 1) / TileStore::TILE_SIZE;
+	int tilesZ = (header.z_size + TileStore::TILE_SIZE - 1) / TileStore::TILE_SIZE;
+	if (size < fileSizeFor(tilesX, tilesZ)) return "file is truncated";
+	return NULL;
+}
+
+#ifdef TILE_STORE_NO_MMAP
+// moves to a byte offset that may not fit in a long
+bool seekTo(FILE *file, size_t offset) {
+#ifdef _WIN32
+	return _fseeki64(file, (__int64)offset, SEEK_SET) == 0;
+#else
+	return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+// length of the file in bytes, which may not fit in a long either
+size_t fileLength(FILE *file) {
+#ifdef _WIN32
+	_fseeki64(file, 0, SEEK_END);
+	return (size_t)_ftelli64(file);
+#else
+	fseeko(file, 0, SEEK_END);
+	return (size_t)ftello(file);
+#endif
+}
+#else
+// maps size bytes of fd, the file can be closed afterwards
+unsigned char *mapFile(int fd, size_t size, bool writable) {
+	void *data = mmap(NULL, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED) return NULL;
+	// tiles are picked out all over the file, reading ahead would bring in tiles outside the budget
+	madvise(data, size, MADV_RANDOM);
+	return (unsigned char*)data;
+}
+#endif
+
+}
+
+TileStore::TileStore() {
+	this->x_size = 0;
+	this->z_size = 0;
+	this->max_height = 1;
+	this->seed = 0;
+	this->tilesX = 0;
+	this->tilesZ = 0;
+	this->file = NULL;
+	this->writable = false;
+	this->fileSize = 0;
+	this->mapping = NULL;
+	this->residentCount = 0;
+	this->setBudget(DEFAULT_BUDGET);
+	this->resetCounters();
+}
+
+TileStore::~TileStore() {
+	this->close();
+}
+
+bool TileStore::isOpen() const {
+	return this->mapping || this->file;
+}
+
+/**
+* Sizes the file for the grid. The tiles start out as zeroes without being
+* written, the file system fills them in.
+*/
+bool TileStore::create(const char *file, int x_size, int z_size, const char **error) {
+	this->close();
+	if (x_size < 1 || z_size < 1) {
+		*error = "sizes must be positive";
+		return false;
+	}
+	int tilesX = (x_size + TILE_SIZE - 1) / TILE_SIZE;
+	int tilesZ = (z_size + TILE_SIZE - 1) / TILE_SIZE;
+	size_t size = fileSizeFor(tilesX, tilesZ);
+
+#ifdef TILE_STORE_NO_MMAP
+	this->file = fopen(file, "w+b");
+	if (!this->file) {
+		*error = "could not create the file";
+		return false;
+	}
+	if (!seekTo(this->file, size - 1) || fputc(0, this->file) == EOF) {
+		fclose(this->file);
+		this->file = NULL;
+		*error = "could not size the file";
+		return false;
+	}
+#else
+	int fd = ::open(file, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		*error = "could not create the file";
+		return false;
+	}
+	if (ftruncate(fd, size) != 0) {
+		::close(fd);
+		*error = "could not size the file";
+		return false;
+	}
+	this->mapping = mapFile(fd, size, true);
+	::close(fd);
+	if (!this->mapping) {
+		*error = "could not map the file";
+		return false;
+	}
+#endif
+
+	this->x_size = x_size;
+	this->z_size = z_size;
+	this->tilesX = tilesX;
+	this->tilesZ = tilesZ;
+	this->max_height = 1;
+	this->seed = 0;
+	this->writable = true;
+	this->fileSize = size;
+	this->writeHeader();
+
+	size_t tiles = (size_t)tilesX * tilesZ;
+	this->resident.assign(tiles, 0);
+	this->lruPosition.resize(tiles);
+	this->buffers.assign(tiles, (float*)NULL);
+	this->dirty.assign(tiles, 0);
+	this->resetCounters();
+	return true;
+}
+
+bool TileStore::open(const char *file, bool writable, const char **error) {
+	this->close();
+	Header header;
+	size_t size = 0;
+
+#ifdef TILE_STORE_NO_MMAP
+	this->file = fopen(file, writable ? "r+b" : "rb");
+	if (!this->file) {
+		*error = "could not open the file";
+		return false;
+	}
+	if (!seekTo(this->file, 0) || fread(&header, sizeof(header), 1, this->file) != 1) {
+		memset(&header, 0, sizeof(header));
+	}
+	size = fileLength(this->file);
+	const char *problem = checkHeader(header, size);
+	if (problem) {
+		fclose(this->file);
+		this->file = NULL;
+		*error = problem;
+		return false;
+	}
+#else
+	int fd = ::open(file, writable ? O_RDWR : O_RDONLY);
+	if (fd < 0) {
+		*error = "could not open the file";
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < HEADER_BYTES) {
+		::close(fd);
+		*error = "not a tiled heightmap";
+		return false;
+	}
+	size = st.st_size;
+	this->mapping = mapFile(fd, size, writable);
+	::close(fd);
+	if (!this->mapping) {
+		*error = "could not map the file";
+		return false;
+	}
+	memcpy(&header, this->mapping, sizeof(header));
+	const char *problem = checkHeader(header, size);
+	if (problem) {
+		munmap(this->mapping, size);
+		this->mapping = NULL;
+		*error = problem;
+		return false;
+	}
+#endif
+
+	this->x_size = header.x_size;
+	this->z_size = header.z_size;
+	this->tilesX = (header.x_size + TILE_SIZE - 1) / TILE_SIZE;
+	this->tilesZ = (header.z_size + TILE_SIZE - 1) / TILE_SIZE;
+	this->max_height = header.max_height;
+	this->seed = header.seed;
+	this->writable = writable;
+	this->fileSize = size;
+
+	size_t tiles = (size_t)this->tilesX * this->tilesZ;
+	this->resident.assign(tiles, 0);
+	this->lruPosition.resize(tiles);
+	this->buffers.assign(tiles, (float*)NULL);
+	this->dirty.assign(tiles, 0);
+	this->resetCounters();
+	return true;
+}
+
+/**
+* Drops every tile (writing back changes, where they aren't mapped) and closes the file.
+*/
+void TileStore::close() {
+	if (!this->isOpen()) return;
+	if (this->writable) this->writeHeader();
+	while (!this->lru.empty()) this->evict(this->lru.back());
+
+#ifdef TILE_STORE_NO_MMAP
+	fclose(this->file);
+#else
+	munmap(this->mapping, this->fileSize);
+#endif
+	this->file = NULL;
+	this->mapping = NULL;
+	this->resident.clear();
+	this->lruPosition.clear();
+	this->buffers.clear();
+	this->dirty.clear();
+	this->x_size = 0;
+	this->z_size = 0;
+	this->tilesX = 0;
+	this->tilesZ = 0;
+	this->fileSize = 0;
+	this->writable = false;
+}
+
+void TileStore::writeHeader() {
+	Header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.x_size = this->x_size;
+	header.z_size = this->z_size;
+	header.tile_size = TILE_SIZE;
+	header.max_height = this->max_height;
+	header.seed = this->seed;
+#ifdef TILE_STORE_NO_MMAP
+	seekTo(this->file, 0);
+	fwrite(&header, sizeof(header), 1, this->file);
+#else
+	memcpy(this->mapping, &header, sizeof(header));
+#endif
+}
+
+const float *TileStore::tile(int tx, int tz) {
+	return this->touch(tx * this->tilesZ + tz, false);
+}
+
+float *TileStore::writableTile(int tx, int tz) {
+	return this->touch(tx * this->tilesZ + tz, true);
+}
+
+/**
+* Room is made before a tile comes in, so the budget is never overrun even briefly.
+*/
+float *TileStore::touch(int index, bool write) {
+	if (this->resident[index]) {
+		this->lru.splice(this->lru.begin(), this->lru, this->lruPosition[index]);
+	} else {
+		while (this->residentCount >= this->maxResident) this->evict(this->lru.back());
+
+#ifdef TILE_STORE_NO_MMAP
+		float *buffer = (float*)malloc(TILE_BYTES);
+		if (!buffer) throw std::bad_alloc();
+		if (!seekTo(this->file, HEADER_BYTES + (size_t)index * TILE_BYTES) ||
+				fread(buffer, TILE_BYTES, 1, this->file) != 1) {
+			memset(buffer, 0, TILE_BYTES);
+		}
+		this->buffers[index] = buffer;
+#else
+		// read the whole tile in one go rather than faulting a page at a time
+		madvise(this->mapping + HEADER_BYTES + (size_t)index * TILE_BYTES, TILE_BYTES, MADV_WILLNEED);
+#endif
+
+		this->lru.push_front(index);
+		this->lruPosition[index] = this->lru.begin();
+		this->resident[index] = 1;
+		this->residentCount++;
+		this->pageIns++;
+		this->peakResident = std::max(this->peakResident, this->residentCount);
+	}
+	if (write) this->dirty[index] = 1;
+
+#ifdef TILE_STORE_NO_MMAP
+	return this->buffers[index];
+#else
+	return (float*)(this->mapping + HEADER_BYTES + (size_t)index * TILE_BYTES);
+#endif
+}
+
+void TileStore::evict(int index) {
+#ifdef TILE_STORE_NO_MMAP
+	if (this->dirty[index] && seekTo(this->file, HEADER_BYTES + (size_t)index * TILE_BYTES)) {
+		fwrite(this->buffers[index], TILE_BYTES, 1, this->file);
+	}
+	free(this->buffers[index]);
+	this->buffers[index] = NULL;
+#else
+	// the mapping is shared, so changes are already in the file's pages and
+	// this only takes the tile out of our memory. touching it reads it back.
+	madvise(this->mapping + HEADER_BYTES + (size_t)index * TILE_BYTES, TILE_BYTES, MADV_DONTNEED);
+#endif
+	this->dirty[index] = 0;
+	this->lru.erase(this->lruPosition[index]);
+	this->resident[index] = 0;
+	this->residentCount--;
+	this->evictions++;
+}
+
+/**
+* Copies a tile at a time, each tile is only paged in once.
+*/
+void TileStore::read(int x0, int z0, int x1, int z1, float *out) {
+	if (x1 <= x0 || z1 <= z0) return;
+	int width = z1 - z0;
+	for (int tx = x0 / TILE_SIZE; tx <= (x1 - 1) / TILE_SIZE; tx++) {
+		int r0 = std::max(x0, tx * TILE_SIZE);
+		int r1 = std::min(x1, (tx + 1) * TILE_SIZE);
+		for (int tz = z0 / TILE_SIZE; tz <= (z1 - 1) / TILE_SIZE; tz++) {
+			int c0 = std::max(z0, tz * TILE_SIZE);
+			int c1 = std::min(z1, (tz + 1) * TILE_SIZE);
+			const float *tile = this->tile(tx, tz);
+			for (int x = r0; x < r1; x++) {
+				memcpy(out + (size_t)(x - x0) * width + (c0 - z0),
+					tile + (x - tx * TILE_SIZE) * TILE_SIZE + (c0 - tz * TILE_SIZE), (c1 - c0) * sizeof(float));
+			}
+		}
+	}
+}
+
+void TileStore::downsample(int level, Grid<float> &out) {
+	int step = 1 << level;
+	out.resize((this->x_size + step - 1) >> level, (this->z_size + step - 1) >> level);
+	out.fill(-FLT_MAX);
+	for (int tx = 0; tx < this->tilesX; tx++) {
+		for (int tz = 0; tz < this->tilesZ; tz++) {
+			const float *tile = this->tile(tx, tz);
+			int x1 = std::min((tx + 1) * TILE_SIZE, this->x_size);
+			int z1 = std::min((tz + 1) * TILE_SIZE, this->z_size);
+			for (int x = tx * TILE_SIZE; x < x1; x++) {
+				const float *row = tile + (x - tx * TILE_SIZE) * TILE_SIZE;
+				float *target = out.row(x >> level);
+				for (int z = tz * TILE_SIZE; z < z1; z++) {
+					float h = row[z - tz * TILE_SIZE];
+					float &m = target[z >> level];
+					if (h > m) m = h;
+				}
+			}
+		}
+	}
+}
+
+/**
+* Drops tiles straight away if the new budget is smaller than what's resident.
+*/
+void TileStore::setBudget(size_t bytes) {
+	this->maxResident = (int)std::max<size_t>(bytes / TILE_BYTES, 1);
+	while (this->residentCount > this->maxResident) this->evict(this->lru.back());
+}
+
+size_t TileStore::budget() const {
+	return (size_t)this->maxResident * TILE_BYTES;
+}
+
+void TileStore::resetCounters() {
+	this->pageIns = 0;
+	this->evictions = 0;
+	this->peakResident = this->residentCount;
+}
@@ -0,0 +1,116 @@
+#ifndef TILE_STORE_H
+#define TILE_STORE_H
+
+#include "grid.h"
+#include <vector>
+#include <list>
+#include <cstdio>
+#include <cstddef>
+
+/**
+* A heightmap kept on disk in square tiles, for terrains too big to hold in
+* memory. The file is a header followed by the tiles (row-major, like the
+* grids), each tile being TILE_SIZE rows of TILE_SIZE heights, so a tile is
+* a handful of whole pages that can be brought in and dropped on their own.
+*
+* The file is memory-mapped (or read a tile at a time where mmap isn't
+* available). A tile is paged in the first time it's touched, and once more
+* tiles are resident than the budget allows the least recently used one is
+* dropped again, so memory use is bounded by what's being worked on rather
+* than by the size of the terrain. Dropped tiles are still in the file,
+* touching one again just pages it back in.
+*/
+class TileStore {
+public:
+	// size of the (square) tiles, in cells
+	static const int TILE_SIZE = 64;
+
+	TileStore();
+	~TileStore();
+
+	// creates (or overwrites) file holding an x_size by z_size heightmap of zeroes, open
+	// for writing. on failure returns false and points error at a description.
+	bool create(const char *file, int x_size, int z_size, const char **error);
+
+	// opens an existing file, only for reading unless writable is set
+	bool open(const char *file, bool writable, const char **error);
+
+	// writes the header (max_height and seed) if the file is writable and closes it
+	void close();
+
+	bool isOpen() const;
+
+	// size of the grid x, z
+	int x_size;
+	int z_size;
+
+	// maximum height in the heightmap, and the seed it was generated with
+	float max_height;
+	unsigned int seed;
+
+	// number of tiles along x and z
+	int tilesX;
+	int tilesZ;
+
+	// the heights of tile (tx, tz), TILE_SIZE rows of TILE_SIZE values, paged in if it
+	// isn't already. heights past the edge of the grid are padding. the pointer is only
+	// good until the next call that could page another tile in.
+	const float *tile(int tx, int tz);
+
+	// the same, for changing the heights (the file has to be writable)
+	float *writableTile(int tx, int tz);
+
+	// copies the heights of rows [x0, x1) and columns [z0, z1) into out, row by row
+	void read(int x0, int z0, int x1, int z1, float *out);
+
+	// fills out with the highest height in each 2^level by 2^level square,
+	// visiting every tile once
+	void downsample(int level, Grid<float> &out);
+
+	// how much memory (in bytes) resident tiles may take up. at least one tile always fits.
+	void setBudget(size_t bytes);
+	size_t budget() const;
+	int budgetTiles() const { return this->maxResident; }
+
+	// tiles in memory right now
+	int residentTiles() const { return this->residentCount; }
+
+	// counters since the file was opened (or resetCounters()): tiles paged in, tiles
+	// dropped to stay in the budget, and the most tiles that were ever resident at once
+	long pageIns;
+	long evictions;
+	int peakResident;
+	void resetCounters();
+
+private:
+	// the store owns the mapping, so it can't be copied
+	TileStore(const TileStore &other);
+	TileStore &operator=(const TileStore &other);
+
+	void writeHeader();
+
+	// makes tile index resident and the most recently used one, dropping others past the budget
+	float *touch(int index, bool write);
+	void evict(int index);
+
+	// the file, when it's read a tile at a time instead of mapped
+	FILE *file;
+	bool writable;
+	size_t fileSize;
+
+	// the tiles, when the whole file is mapped
+	unsigned char *mapping;
+
+	// resident tiles, most recently used first, and where each one is in the list
+	std::list<int> lru;
+	std::vector<std::list<int>::iterator> lruPosition;
+	std::vector<unsigned char> resident;
+	int residentCount;
+	int maxResident;
+
+	// without mmap, each resident tile has its own buffer, and is written back if it changed
+	std::vector<float*> buffers;
+	std::vector<unsigned char> dirty;
+};
+
+#endif
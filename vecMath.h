@@ -0,0 +1,180 @@
+#ifndef VEC_MATH_H
+#define VEC_MATH_H
+
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define VEC_MATH_AVX
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define VEC_MATH_SSE
+#endif
+
+/**
+* Inline vector math for the hot loops.
+*
+* The scalar helpers are constexpr, so they can be used in constants and
+* inlined anywhere. The batch functions work on runs of vectors stored as
+* structure of arrays (all the x components, then all the y, then all the z),
+* VEC_LANES at a time with AVX (when built with -mavx) or SSE, and a scalar
+* loop for whatever doesn't fill a whole set of lanes. Each is built on a
+* lane-level function (normalizeLanes and so on) that kernels producing
+* vectors in registers, like the normal pass, call directly so the vectors
+* never go through memory.
+*/
+
+constexpr float VEC_PI = 3.14159265358979f;
+
+constexpr float degreesToRadians(float degrees) {
+	return degrees * (VEC_PI / 180);
+}
+
+constexpr float square(float x) {
+	return x * x;
+}
+
+constexpr float dot3(float ax, float ay, float az, float bx, float by, float bz) {
+	return ax * bx + ay * by + az * bz;
+}
+
+// squared length of (x, y, z), for comparing lengths without a square root
+constexpr float lengthSquared3(float x, float y, float z) {
+	return x * x + y * y + z * z;
+}
+
+// a run of 3D vectors as structure of arrays: vector i is (x[i], y[i], z[i])
+struct Vec3Span {
+	float *x;
+	float *y;
+	float *z;
+};
+
+#if defined(VEC_MATH_AVX)
+typedef __m256 Lanes;
+const int VEC_LANES = 8;
+inline Lanes lanesSet(float v) { return _mm256_set1_ps(v); }
+inline Lanes lanesLoad(const float *p) { return _mm256_loadu_ps(p); }
+inline void lanesStore(float *p, Lanes v) { _mm256_storeu_ps(p, v); }
+inline Lanes lanesAdd(Lanes a, Lanes b) { return _mm256_add_ps(a, b); }
+inline Lanes lanesSub(Lanes a, Lanes b) { return _mm256_sub_ps(a, b); }
+inline Lanes lanesMul(Lanes a, Lanes b) { return _mm256_mul_ps(a, b); }
+inline Lanes lanesDiv(Lanes a, Lanes b) { return _mm256_div_ps(a, b); }
+inline Lanes lanesSqrt(Lanes a) { return _mm256_sqrt_ps(a); }
+#elif defined(VEC_MATH_SSE)
+typedef __m128 Lanes;
+const int VEC_LANES = 4;
+inline Lanes lanesSet(float v) { return _mm_set1_ps(v); }
+inline Lanes lanesLoad(const float *p) { return _mm_loadu_ps(p); }
+inline void lanesStore(float *p, Lanes v) { _mm_storeu_ps(p, v); }
+inline Lanes lanesAdd(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+inline Lanes lanesSub(Lanes a, Lanes b) { return _mm_sub_ps(a, b); }
+inline Lanes lanesMul(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+inline Lanes lanesDiv(Lanes a, Lanes b) { return _mm_div_ps(a, b); }
+inline Lanes lanesSqrt(Lanes a) { return _mm_sqrt_ps(a); }
+#else
+typedef float Lanes;
+const int VEC_LANES = 1;
+inline Lanes lanesSet(float v) { return v; }
+inline Lanes lanesLoad(const float *p) { return *p; }
+inline void lanesStore(float *p, Lanes v) { *p = v; }
+inline Lanes lanesAdd(Lanes a, Lanes b) { return a + b; }
+inline Lanes lanesSub(Lanes a, Lanes b) { return a - b; }
+inline Lanes lanesMul(Lanes a, Lanes b) { return a * b; }
+inline Lanes lanesDiv(Lanes a, Lanes b) { return a / b; }
+inline Lanes lanesSqrt(Lanes a) { return sqrtf(a); }
+#endif
+
+// 1 / sqrt(a), exactly rather than with the approximate instructions, so results match the scalar code
+inline Lanes lanesInvSqrt(Lanes a) {
+	return lanesDiv(lanesSet(1.0f), lanesSqrt(a));
+}
+
+inline Lanes lanesDot3(Lanes ax, Lanes ay, Lanes az, Lanes bx, Lanes by, Lanes bz) {
+	return lanesAdd(lanesAdd(lanesMul(ax, bx), lanesMul(ay, by)), lanesMul(az, bz));
+}
+
+// normalizes VEC_LANES vectors in place
+inline void normalizeLanes(Lanes &x, Lanes &y, Lanes &z) {
+	Lanes inv = lanesInvSqrt(lanesDot3(x, y, z, x, y, z));
+	x = lanesMul(x, inv);
+	y = lanesMul(y, inv);
+	z = lanesMul(z, inv);
+}
+
+// (ax, ay, az) x (bx, by, bz) for VEC_LANES vectors into (x, y, z)
+inline void crossLanes(Lanes ax, Lanes ay, Lanes az, Lanes bx, Lanes by, Lanes bz, Lanes &x, Lanes &y, Lanes &z) {
+	x = lanesSub(lanesMul(ay, bz), lanesMul(az, by));
+	y = lanesSub(lanesMul(az, bx), lanesMul(ax, bz));
+	z = lanesSub(lanesMul(ax, by), lanesMul(ay, bx));
+}
+
+// the distances between VEC_LANES pairs of points
+inline Lanes distanceLanes(Lanes ax, Lanes ay, Lanes az, Lanes bx, Lanes by, Lanes bz) {
+	Lanes dx = lanesSub(bx, ax), dy = lanesSub(by, ay), dz = lanesSub(bz, az);
+	return lanesSqrt(lanesDot3(dx, dy, dz, dx, dy, dz));
+}
+
+// name of the instruction set the lanes were built with
+inline const char *vecMathName() {
+#if defined(VEC_MATH_AVX)
+	return "AVX";
+#elif defined(VEC_MATH_SSE)
+	return "SSE";
+#else
+	return "scalar";
+#endif
+}
+
+/**
+* Normalizes count vectors of in into out, which can be the same span.
+* Like Vec3D::normalize, zero length vectors come out as NaN.
+*/
+inline void normalizeN(Vec3Span in, Vec3Span out, int count) {
+	int i = 0;
+	for (; i + VEC_LANES <= count; i += VEC_LANES) {
+		Lanes x = lanesLoad(in.x + i), y = lanesLoad(in.y + i), z = lanesLoad(in.z + i);
+		normalizeLanes(x, y, z);
+		lanesStore(out.x + i, x);
+		lanesStore(out.y + i, y);
+		lanesStore(out.z + i, z);
+	}
+	for (; i < count; i++) {
+		float inv = 1.0f / sqrtf(lengthSquared3(in.x[i], in.y[i], in.z[i]));
+		out.x[i] = in.x[i] * inv;
+		out.y[i] = in.y[i] * inv;
+		out.z[i] = in.z[i] * inv;
+	}
+}
+
+// out[i] = a[i] x b[i] for count vectors. out can't be a or b
+inline void crossN(Vec3Span a, Vec3Span b, Vec3Span out, int count) {
+	int i = 0;
+	for (; i + VEC_LANES <= count; i += VEC_LANES) {
+		Lanes x, y, z;
+		crossLanes(lanesLoad(a.x + i), lanesLoad(a.y + i), lanesLoad(a.z + i),
+			lanesLoad(b.x + i), lanesLoad(b.y + i), lanesLoad(b.z + i), x, y, z);
+		lanesStore(out.x + i, x);
+		lanesStore(out.y + i, y);
+		lanesStore(out.z + i, z);
+	}
+	for (; i < count; i++) {
+		out.x[i] = a.y[i] * b.z[i] - a.z[i] * b.y[i];
+		out.y[i] = a.z[i] * b.x[i] - a.x[i] * b.z[i];
+		out.z[i] = a.x[i] * b.y[i] - a.y[i] * b.x[i];
+	}
+}
+
+// out[i] = the distance between points a[i] and b[i], for count points
+inline void distanceN(Vec3Span a, Vec3Span b, float *out, int count) {
+	int i = 0;
+	for (; i + VEC_LANES <= count; i += VEC_LANES) {
+		lanesStore(out + i, distanceLanes(lanesLoad(a.x + i), lanesLoad(a.y + i), lanesLoad(a.z + i),
+			lanesLoad(b.x + i), lanesLoad(b.y + i), lanesLoad(b.z + i)));
+	}
+	for (; i < count; i++) {
+		out[i] = sqrtf(lengthSquared3(b.x[i] - a.x[i], b.y[i] - a.y[i], b.z[i] - a.z[i]));
+	}
+}
+
+#endif